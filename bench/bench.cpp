@@ -0,0 +1,282 @@
+// A small throughput benchmark of the tokenizer and the parser.
+//
+// Build it in release mode in order to get meaningful numbers:
+//
+// $ cmake -S. -Bbuild -DCMAKE_BUILD_TYPE=Release -DFMI_JSON_PARSER_BUILD_BENCHMARKS=ON
+// $ cmake --build build && ./build/bench/json-parser-bench [size in MiB]
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <fstream>
+#include <filesystem>
+namespace fs = std::filesystem;
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <zlib.h>
+
+#include <json-parser/parser.h>
+#include <json-parser/tokenizer.h>
+#include <json-parser/input_reader.h>
+#include <json-parser/simd.h>
+
+using namespace json_parser;
+
+// Produces an array of records which looks like the output of `json::dump` or the same
+// without any whitespace.
+static std::string generate_document(std::size_t approx_size, bool pretty = true) {
+    const char *nl = pretty ? "\n" : "";
+    const char *indent = pretty ? "  " : "";
+    const char *sep = pretty ? " : " : ":";
+
+    std::string doc = std::string{"["} + nl;
+    for (std::size_t i = 0; doc.size() < approx_size; ++i) {
+        if (i > 0)
+            doc += std::string{","} + nl;
+        auto field = [&](const std::string &key, const std::string &value, bool last = false) {
+            doc += std::string{indent} + indent + "\"" + key + "\"" + sep + value + (last ? "" : ",") + nl;
+        };
+        doc += std::string{indent} + "{" + nl;
+        field("id", std::to_string(i));
+        field("name", "\"record number " + std::to_string(i) + "\"");
+        field("score", std::to_string(i * 0.25));
+        field("active", i % 2 ? "true" : "false");
+        field("parent", "null");
+        const std::string item_indent = std::string{indent} + indent + indent;
+        field("tags", std::string{"["} + nl
+                      + item_indent + "\"alpha\"," + nl
+                      + item_indent + "\"beta\"," + nl
+                      + item_indent + "\"gamma\"" + nl
+                      + indent + indent + "]", true);
+        doc += std::string{indent} + "}";
+    }
+    doc += std::string{nl} + "]";
+    return doc;
+}
+
+// Produces an array of long strings of base64-looking text.
+static std::string generate_blobs(std::size_t approx_size) {
+    static const char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    std::string doc = "[";
+    for (std::size_t i = 0; doc.size() < approx_size; ++i) {
+        if (i > 0)
+            doc += ',';
+        doc += '"';
+        for (std::size_t j = 0; j < 4096; ++j)
+            doc += alphabet[(i * 7 + j * 13) % 64];
+        doc += '"';
+    }
+    doc += ']';
+    return doc;
+}
+
+// Produces an array of arrays of numbers, like the telemetry we keep getting.
+static std::string generate_numbers(std::size_t approx_size) {
+    std::string doc = "[";
+    for (std::size_t i = 0; doc.size() < approx_size; ++i) {
+        if (i > 0)
+            doc += ',';
+        doc += '[' + std::to_string(i) + ',' + std::to_string(i * 0.001) + ',' + std::to_string(-static_cast<double>(i) / 7)
+               + ",1.5e-" + std::to_string(i % 300) + ']';
+    }
+    doc += ']';
+    return doc;
+}
+
+// Asks the kernel to forget the cached pages of the file, so that it is read from the disk again.
+static void evict_from_page_cache(const std::string &path) {
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return;
+    ::fdatasync(fd);
+    ::posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+    ::close(fd);
+}
+
+// Runs `fn` a couple of times and returns the best time in seconds.
+template <typename Fn>
+static double measure(Fn &&fn, int repetitions = 5, const std::string *cold_path = nullptr) {
+    double best = 1e100;
+    for (int i = 0; i < repetitions; ++i) {
+        if (cold_path)
+            evict_from_page_cache(*cold_path);
+        const auto start = std::chrono::steady_clock::now();
+        fn();
+        const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        best = std::min(best, elapsed.count());
+    }
+    return best;
+}
+
+static void report(const char *name, std::size_t bytes, double seconds) {
+    const double mib = static_cast<double>(bytes) / (1024.0 * 1024.0);
+    std::printf("%-40s %10.2f ms %10.2f MiB/s\n", name, seconds * 1e3, mib / seconds);
+}
+
+template <typename InputReader, typename ...Args>
+static std::size_t tokenize(Args &&...args) {
+    tokenizer<InputReader> t{InputReader{std::forward<Args>(args)...}};
+    std::size_t num_tokens = 0;
+    for (auto it = t.begin(); it != t.end(); ++it) {
+        (void) *it;
+        ++num_tokens;
+    }
+    return num_tokens;
+}
+
+template <typename InputReader, typename ...Args>
+static void parse(Args &&...args) {
+    const json parsed = parser<InputReader>{InputReader{std::forward<Args>(args)...}}();
+    if (parsed.empty())
+        std::abort();
+}
+
+int main(int argc, char **argv) {
+    const std::size_t size_mib = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 16;
+    const std::string doc = generate_document(size_mib * 1024 * 1024);
+
+    const std::string path = (fs::temp_directory_path() / "fmi-json-parser-bench.json").string();
+    std::ofstream{path, std::ios::trunc | std::ios::out} << doc;
+
+    const std::string gz_path = path + ".gz";
+    gzFile gz = gzopen(gz_path.c_str(), "wb6");
+    gzwrite(gz, doc.data(), static_cast<unsigned>(doc.size()));
+    gzclose(gz);
+
+    std::printf("Document: %zu bytes\n", doc.size());
+
+    const simd::isa best_isa = simd::active_isa();
+    for (simd::isa which : {simd::isa::scalar, simd::isa::sse42, simd::isa::avx2}) {
+        if (!simd::select_isa(which))
+            continue;
+        std::vector<std::uint32_t> positions;
+        positions.reserve(doc.size() / 4);
+        const std::string name = std::string{"index_structurals "} + simd::isa_name(which);
+        report(name.c_str(), doc.size(), measure([&] {
+            positions.clear();
+            simd::index_structurals(doc, positions);
+        }));
+    }
+    // Text in a couple of scripts, so that the validation cannot take the ASCII shortcut.
+    std::string text;
+    while (text.size() < size_mib * 1024 * 1024)
+        text += "Hello, \xd0\xbc\xd0\xb8\xd1\x80! \xe4\xb8\x96\xe7\x95\x8c \xf0\x9f\x8c\x8d caf\xc3\xa9 ";
+    for (simd::isa which : {simd::isa::scalar, simd::isa::sse42, simd::isa::avx2}) {
+        if (!simd::select_isa(which))
+            continue;
+        const std::string name = std::string{"validate_utf8 "} + simd::isa_name(which);
+        report(name.c_str(), text.size(), measure([&] {
+            if (!simd::validate_utf8(text))
+                std::abort();
+        }));
+    }
+    simd::select_isa(best_isa);
+    std::printf("Using the %s kernels\n", simd::isa_name(best_isa));
+
+    // Pretty-printed documents are mostly indentation, so they show off the whitespace skipping.
+    const std::string minified = generate_document(size_mib * 1024 * 1024, false);
+    // And these are mostly string bodies (think base64 blobs), which show off the string scanning.
+    const std::string blobs = generate_blobs(size_mib * 1024 * 1024);
+    const std::string numbers = generate_numbers(size_mib * 1024 * 1024);
+    report("tokenize numbers", numbers.size(), measure([&] { tokenize<view_input_reader>(std::string_view{numbers}); }));
+    for (simd::isa which : {simd::isa::scalar, best_isa}) {
+        simd::select_isa(which);
+        const std::string pretty_name = std::string{"tokenize pretty "} + simd::isa_name(which);
+        const std::string minified_name = std::string{"tokenize minified "} + simd::isa_name(which);
+        report(pretty_name.c_str(), doc.size(), measure([&] { tokenize<view_input_reader>(std::string_view{doc}); }));
+        report(minified_name.c_str(), minified.size(), measure([&] { tokenize<view_input_reader>(std::string_view{minified}); }));
+        const std::string blobs_name = std::string{"tokenize blobs "} + simd::isa_name(which);
+        report(blobs_name.c_str(), blobs.size(), measure([&] { tokenize<view_input_reader>(std::string_view{blobs}); }));
+    }
+    simd::select_isa(best_isa);
+
+    report("tokenize ifs_input_reader", doc.size(), measure([&] { tokenize<ifs_input_reader>(path); }));
+    report("tokenize buf_input_reader", doc.size(), measure([&] { tokenize<buf_input_reader>(path); }));
+    report("tokenize mmap_input_reader", doc.size(), measure([&] { tokenize<mmap_input_reader>(path); }));
+    report("tokenize async_input_reader", doc.size(), measure([&] { tokenize<async_input_reader>(path); }));
+    report("tokenize compressed_input_reader", doc.size(), measure([&] { tokenize<compressed_input_reader>(gz_path); }));
+    report("tokenize str_input_reader", doc.size(), measure([&] { tokenize<str_input_reader>(doc); }));
+    report("tokenize view_input_reader", doc.size(), measure([&] { tokenize<view_input_reader>(std::string_view{doc}); }));
+
+    report("parse mmap_input_reader", doc.size(), measure([&] { parse<mmap_input_reader>(path); }));
+    report("parse buf_input_reader", doc.size(), measure([&] { parse<buf_input_reader>(path); }));
+    report("parse async_input_reader", doc.size(), measure([&] { parse<async_input_reader>(path); }));
+    report("parse view_input_reader", doc.size(), measure([&] { parse<view_input_reader>(std::string_view{doc}); }));
+    // With an owner the strings may refer to the input instead of being copied out of it.
+    const auto shared_blobs = std::make_shared<const std::string>(blobs);
+    report("parse blobs view_input_reader", blobs.size(), measure([&] { parse<view_input_reader>(std::string_view{blobs}); }));
+    report("parse blobs view_input_reader+owner", blobs.size(), measure([&] {
+        parse<view_input_reader>(std::string_view{*shared_blobs}, shared_blobs);
+    }));
+    report("parse str_input_reader", doc.size(), measure([&] { parse<str_input_reader>(doc); }));
+    report("tape view_input_reader", doc.size(), measure([&] {
+        if (view_tokenizer{view_input_reader{std::string_view{doc}}}.tape().empty())
+            std::abort();
+    }));
+    // On as many threads as there are, and on a fixed few to see what the splitting costs.
+    for (std::size_t threads : {std::size_t{std::thread::hardware_concurrency()}, std::size_t{4}}) {
+        const std::string name = "tape parallel (" + std::to_string(threads) + " threads)";
+        report(name.c_str(), doc.size(), measure([&] {
+            if (parallel_tape(doc, threads).empty())
+                std::abort();
+        }));
+    }
+    // Only counts the values, without building the JSON.
+    struct counting_handler {
+        std::size_t values = 0;
+        void on_null() { ++values; }
+        void on_bool(bool) { ++values; }
+        void on_number(const token_number &) { ++values; }
+        void on_string(std::string_view) { ++values; }
+        void on_key(std::string_view) {}
+        void on_array_begin() {}
+        void on_array_end() { ++values; }
+        void on_object_begin() {}
+        void on_object_end() { ++values; }
+    };
+    report("parse view_input_reader into handler", doc.size(), measure([&] {
+        counting_handler handler;
+        view_parser{view_input_reader{std::string_view{doc}}}.parse(handler);
+        if (handler.values == 0)
+            std::abort();
+    }));
+    report("parse view_input_reader via tape", doc.size(), measure([&] {
+        if (view_parser{view_input_reader{std::string_view{doc}}}.parse_via_tape().empty())
+            std::abort();
+    }));
+
+    // Lots of small documents which are not valid, the way they come from the untrusted clients.
+    std::vector<std::string> invalid;
+    std::size_t invalid_size = 0;
+    for (std::size_t i = 0; invalid_size < size_mib * 1024 * 1024 / 16; ++i) {
+        const char *kinds[] = {R"({"id": 1, "name": "x" "y"})", R"([1, 2, 3)", R"({"text": "abc\)", R"([true, nul])"};
+        invalid.push_back(kinds[i % 4]);
+        invalid_size += invalid.back().size();
+    }
+    report("parse invalid (exceptions)", invalid_size, measure([&] {
+        for (const std::string &input : invalid) {
+            try {
+                (void) view_parser{view_input_reader{std::string_view{input}}}();
+                std::abort();
+            } catch (const parser_exception &) {
+            }
+        }
+    }));
+    report("parse invalid (try_parse)", invalid_size, measure([&] {
+        for (const std::string &input : invalid) {
+            if (view_parser{view_input_reader{std::string_view{input}}}.try_parse())
+                std::abort();
+        }
+    }));
+
+    // With a cold page cache the reading is no longer free and is worth overlapping with the parsing.
+    report("parse buf_input_reader (cold)", doc.size(), measure([&] { parse<buf_input_reader>(path); }, 5, &path));
+    report("parse async_input_reader (cold)", doc.size(), measure([&] { parse<async_input_reader>(path); }, 5, &path));
+
+    fs::remove(path);
+    fs::remove(gz_path);
+    return 0;
+}
@@ -0,0 +1,137 @@
+#ifndef FMI_JSON_PARSER_HANDLER_INCLUDED
+#define FMI_JSON_PARSER_HANDLER_INCLUDED
+
+#include <concepts>
+#include <cstdint>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+#include <json-parser/tokenizer.h>
+#include <json-parser/json.h>
+
+namespace json_parser {
+
+///
+/// The `json_handler` concept.
+/// Instead of building a `json`, the parser may just tell a handler what it finds, as it
+/// finds it (see `parser::parse(Handler &)`) - which is all that is needed in order to
+/// count or forward the values, without keeping them around.
+///
+/// The arrays and objects come as a begin and an end, with their values in between. In
+/// objects each value comes right after its key. The strings (and keys) refer to the
+/// input or to the token - they are good only until the handler returns.
+///
+
+template <typename Handler>
+concept json_handler = requires(Handler &handler, std::string_view str, const token_number &number, bool boolean) {
+    handler.on_null();
+    handler.on_bool(boolean);
+    handler.on_number(number);
+    handler.on_string(str);
+    handler.on_key(str);
+    handler.on_array_begin();
+    handler.on_array_end();
+    handler.on_object_begin();
+    handler.on_object_end();
+};
+
+///
+/// The `dom_builder` class.
+/// The handler behind `parser::parse()` - it builds the `json` out of what it is told.
+/// Given what keeps the input alive (and where the input is), the strings which are in
+/// the input as they are refer to it instead of being copied out of it.
+///
+
+class dom_builder {
+public:
+    dom_builder() = default;
+
+    dom_builder(std::shared_ptr<const void> source, std::string_view source_view)
+        : m_source{std::move(source)}
+        , m_source_view{source_view} {}
+
+    void on_null() { add(json::make_node<json::null>()); }
+
+    void on_bool(bool value) {
+        add(json::make_node<json::boolean>(token_keyword{value ? token_keyword::kind::True : token_keyword::kind::False}));
+    }
+
+    void on_number(const token_number &value) { add(json::make_node<json::number>(value)); }
+
+    void on_string(std::string_view value) { add(json::make_node<json::string>(make_string(value))); }
+
+    void on_key(std::string_view key) { m_open.back().key = json::make_node<json::string>(make_string(key)); }
+
+    void on_array_begin() { open<json::array>(); }
+    void on_array_end() { close(); }
+
+    void on_object_begin() { open<json::object>(); }
+    void on_object_end() { close(); }
+
+    /// The whole JSON, once it is done.
+    [[nodiscard]] json take() { return json{std::move(m_root)}; }
+
+private:
+    [[nodiscard]] token_string make_string(std::string_view value) const {
+        const auto at = reinterpret_cast<std::uintptr_t>(value.data());
+        const auto source_at = reinterpret_cast<std::uintptr_t>(m_source_view.data());
+        if (m_source && at >= source_at && at + value.size() <= source_at + m_source_view.size())
+            return token_string{value, m_source};
+        return token_string{std::string{value}};
+    }
+
+    template <typename Container>
+    void open() {
+        frame &top = m_open.emplace_back();
+        top.node = json::make_node<Container>();
+        if constexpr (std::same_as<Container, json::array>)
+            top.array = static_cast<json::array *>(top.node.get());
+        else
+            top.object = static_cast<json::object *>(top.node.get());
+    }
+
+    void close() {
+        json::pmrvalue node = std::move(m_open.back().node);
+        m_open.pop_back();
+        add(std::move(node));
+    }
+
+    // Puts a value which is done in the innermost array or object.
+    void add(json::pmrvalue value) {
+        if (m_open.empty()) {
+            m_root = std::move(value);
+            return;
+        }
+
+        frame &top = m_open.back();
+        if (top.array) {
+            top.array->append(std::move(value));
+        } else {
+            top.object->append(std::move(static_cast<json::string &>(*top.key)), std::move(value));
+            top.key.reset();
+        }
+    }
+
+private:
+    std::shared_ptr<const void> m_source;
+    std::string_view m_source_view;
+
+    // The arrays and objects which are not closed yet, the innermost one last. Exactly one of
+    // `array` and `object` is set - to what `node` is.
+    struct frame {
+        json::pmrvalue node;
+        json::array *array{nullptr};
+        json::object *object{nullptr};
+        // The key whose value is coming next.
+        json::pmrvalue key;
+    };
+    std::vector<frame> m_open;
+    json::pmrvalue m_root;
+};
+
+static_assert(json_handler<dom_builder>);
+
+}
+
+#endif // FMI_JSON_PARSER_HANDLER_INCLUDED
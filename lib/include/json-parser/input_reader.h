@@ -2,7 +2,15 @@
 #define FMI_JSON_PARSER_INPUT_READER_INCLUDED
 
 #include <string>
+#include <span>
+#include <cstring>
+#include <algorithm>
+#include <concepts>
+#include <memory>
+#include <fstream>
 #include <iostream>
+#include <string_view>
+#include <vector>
 #include <assert.h>
 #include <exception>
 
@@ -27,40 +35,58 @@ private:
 };
 
 ///
-/// The `input_reader` class.
-/// Abstract base type for different input reader strategies.
-/// One of them is passed as a template argument to the `tokenizer`
-/// instance that is used. Its role is to serve as an _algorithm strategy_
-/// for acquiring input and reporting problems.
-/// The `input_reader` base is implemented using CRTP in order to be able
-/// to have an API for creating `begin()`/`end()` instances of the _concrete_
-/// type.
-template <typename Concrete>
-class input_reader {
-public:
-    virtual ~input_reader() noexcept = default;
-
-    virtual Concrete begin() const = 0;
-    virtual Concrete end() const = 0;
-
-    virtual bool eof() const = 0;
-    virtual bool ready() const = 0;
+/// The `input_reader_strategy` concept.
+/// It describes the different input reader strategies. One of them is passed
+/// as a template argument to the `tokenizer` instance that is used. Its role
+/// is to serve as an _algorithm strategy_ for acquiring input and reporting
+/// problems. A single instance of the concrete type is owned by the `tokenizer`
+/// and all of its token iterators read through it.
+///
+/// Previously this was an abstract CRTP base with `virtual` operations, so
+/// inlining the per-symbol reads into the tokenizer's loops depended on the
+/// compiler devirtualizing them. Being a concept, it checks the very same
+/// interface at compile-time, while the concrete strategies are plain `final`
+/// classes without a vtable whose members are always candidates for inlining.
+///
+/// Besides reading symbol by symbol, every strategy provides bulk access to the
+/// input: `window(n)` returns the contiguous input starting at the current position
+/// and `advance(k)` moves the position `k` symbols forward. The window holds at least
+/// `n` symbols unless the input ends earlier (or `n` is more than the strategy is
+/// able to buffer at once) and it is empty only at the end of the input. It may hold
+/// more than asked for and stays valid until the reader is modified.
+///
+template <typename T>
+concept input_reader_strategy = requires(T reader, const T &const_reader, typename T::pos_type pos) {
+    { const_reader.eof() } -> std::convertible_to<bool>;
+    { const_reader.ready() } -> std::convertible_to<bool>;
 
     // TODO: Support non-`char` types also.
-    virtual char peek() const = 0;
-    virtual char get() = 0;
+    { const_reader.peek() } -> std::same_as<char>;
+    { reader.get() } -> std::same_as<char>;
 
-    using pos_type = std::size_t;
+    { reader.seek(pos) };
+    { const_reader.tell() } -> std::same_as<typename T::pos_type>;
 
-    virtual void seek(pos_type) = 0;
-    virtual pos_type tell() const = 0;
+    // Bulk access to the input ahead - see `window()` below.
+    { const_reader.window(std::size_t{}) } -> std::same_as<std::span<const char>>;
+    { reader.advance(std::size_t{}) };
 
-    // I cannot put such requirements here, but the derived classes actually have these properties also:
-    //
-    // virtual const Concrete::impl &impl() const = 0;
-    // virtual Concrete::impl &impl() = 0;
-    //
-    // using location_detail = std::size_t;
+    { T::kind() } -> std::convertible_to<const std::string &>;
+};
+
+///
+/// The `stable_input_reader` concept.
+/// Some of the strategies have the whole input in memory which does not move while the
+/// reader is alive, so their windows point right into it. Then tokens (and JSON strings)
+/// may refer to the input instead of copying it out. `keep_alive()` gives whatever owns
+/// that memory, so that the things referring to it can keep it around after the reader is
+/// gone. It may be empty if the reader does not own the memory (and has not been told who
+/// does) - then only the tokens, which do not outlive the reader, refer to it.
+///
+template <typename T>
+concept stable_input_reader = input_reader_strategy<T> && requires(const T &const_reader) {
+    { const_reader.view() } -> std::same_as<std::string_view>;
+    { const_reader.keep_alive() } -> std::convertible_to<std::shared_ptr<const void>>;
 };
 
 ///
@@ -68,8 +94,10 @@ public:
 /// This type implements using a file as an input stream.
 /// On construction guarantees that the input is "ready".
 ///
-class ifs_input_reader final : public input_reader<ifs_input_reader> {
+class ifs_input_reader final {
 public:
+    using pos_type = std::size_t;
+
     explicit ifs_input_reader(const std::string &ifs_filename)
         : m_ifs_filename{ifs_filename}
         , m_ifs{ifs_filename} {
@@ -87,6 +115,7 @@ public:
     ifs_input_reader& operator=(const ifs_input_reader &rhs) {
         m_ifs_filename = rhs.m_ifs_filename;
         m_ifs = std::ifstream { rhs.m_ifs_filename };
+        m_pos = 0;
         return *this;
     }
 
@@ -94,29 +123,52 @@ public:
 
     ifs_input_reader& operator=(ifs_input_reader &&) noexcept = default;
 
-    [[nodiscard]] ifs_input_reader begin() const override {
-        ifs_input_reader copy { *this };
-        copy.m_ifs.seekg(0, std::ios_base::beg);
-        return copy;
-    }
-
-    [[nodiscard]] ifs_input_reader end() const override {
-        ifs_input_reader copy { *this };
-        copy.m_ifs.seekg(0, std::ios_base::end);
-        return copy;
-    }
+    [[nodiscard]] bool ready() const { return m_ifs.is_open() && m_ifs.good(); }
 
-    [[nodiscard]] bool ready() const override { return m_ifs.is_open() && m_ifs.good(); }
+    // The stream sets its "eof" flag only after a read past the end, so peek to find out.
+    [[nodiscard]] bool eof() const { return m_ifs.peek() == std::ifstream::traits_type::eof(); }
 
-    [[nodiscard]] bool eof() const override { return m_ifs.eof(); }
+    [[nodiscard]] char peek() const { return m_ifs.peek(); }
 
-    [[nodiscard]] char peek() const override { return m_ifs.peek(); }
+    [[nodiscard]] char get() {
+        const auto sym = m_ifs.get();
+        if (sym != std::ifstream::traits_type::eof())
+            ++m_pos;
+        return static_cast<char>(sym);
+    }
 
-    [[nodiscard]] char get() override { return m_ifs.get(); }
+    void seek(pos_type pos) {
+        m_ifs.clear();
+        m_ifs.seekg(pos, std::ios_base::beg);
+        m_pos = pos;
+    }
 
-    void seek(pos_type pos) override { m_ifs.seekg(pos, std::ios_base::beg); }
+    // The position is tracked here, as `tellg()` has to ask the OS every time.
+    [[nodiscard]] pos_type tell() const { return m_pos; }
+
+    // The stream's own buffer is not accessible, so the window is a copy that is read
+    // ahead. Then the symbols are put back, which is cheap as long as they are still in the
+    // stream's buffer. Only if they are not, the stream has to be seeked back. That is why
+    // large windows are cut down to what the stream has buffered.
+    [[nodiscard]] std::span<const char> window(std::size_t n) const {
+        auto *buf = m_ifs.rdbuf();
+        const auto buffered = static_cast<std::size_t>(std::max<std::streamsize>(buf->in_avail(), 0));
+        n = std::min(n, std::max(buffered, max_unbuffered_window));
+        m_window.resize(n);
+        const auto count = buf->sgetn(m_window.data(), static_cast<std::streamsize>(n));
+        for (auto left = count; left > 0; --left) {
+            if (buf->sungetc() == std::ifstream::traits_type::eof()) {
+                m_ifs.seekg(-static_cast<std::streamoff>(left), std::ios_base::cur);
+                break;
+            }
+        }
+        return { m_window.data(), static_cast<std::size_t>(count) };
+    }
 
-    [[nodiscard]] pos_type tell() const override { return m_ifs.tellg(); }
+    void advance(std::size_t count) {
+        m_ifs.ignore(static_cast<std::streamsize>(count));
+        m_pos += static_cast<pos_type>(m_ifs.gcount());
+    }
 
     using impl_type = std::ifstream;
     [[nodiscard]] const impl_type &ifs() const { return m_ifs; }
@@ -135,56 +187,74 @@ private:
     // This is the actual input stream.
     // It is mutable because of the `tell()` and `peek()` methods.
     mutable std::ifstream m_ifs;
+
+    // How much may be read ahead past the stream's buffer.
+    static constexpr std::size_t max_unbuffered_window = 256;
+
+    // Holds the last `window()`.
+    mutable std::string m_window;
+
+    pos_type m_pos{0};
 };
 
 ///
 /// The `str_input_reader` class.
 /// This type implements using a raw byte buffer as an input stream. Here the byte buffer
 /// is implemented as a `std::string` as "regular" `char`-s are all we support for now in
-/// terms of character sets.
+/// terms of character sets. The buffer is owned by the reader and shared between its
+/// copies, so creating iterators over it does not copy it over and over again.
 ///
-class str_input_reader final : public input_reader<str_input_reader> {
+class str_input_reader final {
 public:
-    explicit str_input_reader(const std::string &str) : m_str{str} {
+    using pos_type = std::size_t;
+
+    explicit str_input_reader(const std::string &str)
+        : m_str{std::make_shared<const std::string>(str)} {
         // On construction the input is guaranteed to be "ready".
         // Safety: str_input_reader is always ready!
         assert(ready());
     }
 
-    [[nodiscard]] str_input_reader begin() const override {
-        str_input_reader copy { m_str };
-        copy.seek(0);
-        return copy;
-    }
-
-    [[nodiscard]] str_input_reader end() const override {
-        str_input_reader copy { m_str };
-        copy.seek(m_str.size());
-        return copy;
+    explicit str_input_reader(std::string &&str)
+        : m_str{std::make_shared<const std::string>(std::move(str))} {
+        // Safety: str_input_reader is always ready!
+        assert(ready());
     }
 
-    [[nodiscard]] bool ready() const override {
+    [[nodiscard]] bool ready() const {
         // Strings are always ready :D.
         return true;
     }
 
-    [[nodiscard]] bool eof() const override { return !(m_pos < m_str.size()); }
+    [[nodiscard]] bool eof() const { return !(m_pos < m_str->size()); }
 
-    [[nodiscard]] char peek() const override {
-        if (m_pos < m_str.size())
-            return m_str[m_pos];
+    [[nodiscard]] char peek() const {
+        if (m_pos < m_str->size())
+            return (*m_str)[m_pos];
         throw input_reader_exception("Trying to peek at str_input_reader out of bounds.");
     }
 
-    [[nodiscard]] char get() override {
-        if (m_pos < m_str.size())
-            return m_str[m_pos++];
+    [[nodiscard]] char get() {
+        if (m_pos < m_str->size())
+            return (*m_str)[m_pos++];
         throw input_reader_exception("Trying to get from str_input_reader out of bounds.");
     }
 
-    void seek(pos_type pos) override { m_pos = pos; }
+    void seek(pos_type pos) { m_pos = pos; }
 
-    [[nodiscard]] pos_type tell() const override { return m_pos; }
+    [[nodiscard]] pos_type tell() const { return m_pos; }
+
+    [[nodiscard]] std::span<const char> window(std::size_t) const {
+        if (!(m_pos < m_str->size()))
+            return {};
+        return { m_str->data() + m_pos, m_str->size() - m_pos };
+    }
+
+    void advance(std::size_t count) { m_pos += count; }
+
+    [[nodiscard]] std::string_view view() const noexcept { return *m_str; }
+
+    [[nodiscard]] std::shared_ptr<const void> keep_alive() const noexcept { return m_str; }
 
     [[nodiscard]] static const std::string &kind() noexcept {
         static std::string kind = "str_input_reader";
@@ -192,29 +262,752 @@ public:
     }
 
 private:
-    std::string m_str;
+    std::shared_ptr<const std::string> m_str;
     pos_type m_pos{0};
 };
 
 ///
-/// The `is_input_reader` and `is_input_reader_v` traits.
+/// The `view_input_reader` class.
+/// This type implements using a buffer that is owned by the caller as an input stream.
+/// Nothing is copied - neither on construction, nor when the reader itself gets copied,
+/// which makes it the cheapest way to parse data that is already in memory (e.g. a
+/// network buffer). The caller is responsible for keeping the buffer alive while the
+/// reader (and everything created from it) is being used. If the caller passes whatever
+/// owns the buffer along, the parsed JSON refers to the buffer instead of copying its
+/// strings out and keeps it alive on its own.
 ///
-/// They are not really required by the current implementation but I think
-/// they are somewhat usefulfor detecting incorrect "generated" code. For
-/// example I was debugging an instantiation of `input_reader<std::string>`
-/// and was wondering what is going on, so I decided to limit the template
-/// arguments with this cool new think I learned some days ago :D.
+class view_input_reader final {
+public:
+    using pos_type = std::size_t;
 
-template <typename T>
-struct is_input_reader {
-    static constexpr bool value = std::is_base_of_v<input_reader<T>, T>;
+    explicit view_input_reader(std::string_view view, std::shared_ptr<const void> owner = {}) noexcept
+        : m_view{view}
+        , m_owner{std::move(owner)} { }
+
+    // A template so that everything convertible to both (e.g. `std::string`) picks the one above.
+    template <std::size_t Extent>
+    explicit view_input_reader(std::span<const char, Extent> span, std::shared_ptr<const void> owner = {}) noexcept
+        : m_view{span.data(), span.size()}
+        , m_owner{std::move(owner)} { }
+
+    [[nodiscard]] bool ready() const { return true; }
+
+    [[nodiscard]] bool eof() const { return !(m_pos < m_view.size()); }
+
+    [[nodiscard]] char peek() const {
+        if (m_pos < m_view.size())
+            return m_view[m_pos];
+        throw input_reader_exception("Trying to peek at view_input_reader out of bounds.");
+    }
+
+    [[nodiscard]] char get() {
+        if (m_pos < m_view.size())
+            return m_view[m_pos++];
+        throw input_reader_exception("Trying to get from view_input_reader out of bounds.");
+    }
+
+    void seek(pos_type pos) { m_pos = pos; }
+
+    [[nodiscard]] pos_type tell() const { return m_pos; }
+
+    [[nodiscard]] std::span<const char> window(std::size_t) const {
+        if (!(m_pos < m_view.size()))
+            return {};
+        return { m_view.data() + m_pos, m_view.size() - m_pos };
+    }
+
+    void advance(std::size_t count) { m_pos += count; }
+
+    [[nodiscard]] std::string_view view() const noexcept { return m_view; }
+
+    [[nodiscard]] std::shared_ptr<const void> keep_alive() const noexcept { return m_owner; }
+
+    [[nodiscard]] static const std::string &kind() noexcept {
+        static std::string kind = "view_input_reader";
+        return kind;
+    }
+
+private:
+    std::string_view m_view;
+    std::shared_ptr<const void> m_owner;
+    pos_type m_pos{0};
 };
 
-template <typename T>
-inline constexpr bool is_input_reader_v = is_input_reader<T>::value;
+///
+/// The `rope_input_reader` class.
+/// This type implements using a chain of buffers (e.g. the segments a request body is
+/// received in) as a single input stream without concatenating them first. Just like
+/// `view_input_reader` it does not own the buffers, so they have to outlive the reader.
+/// The position is the offset from the start of the first buffer, so seeking works
+/// across the boundaries and the locations come out the same as for a single buffer.
+/// The list of segments is shared between the copies of the reader.
+///
+class rope_input_reader final {
+public:
+    using pos_type = std::size_t;
+
+    explicit rope_input_reader(std::vector<std::span<const char>> segments) {
+        auto r = std::make_shared<rope>();
+        for (auto segment : segments) {
+            // Empty segments would only get in the way of moving to the next one.
+            if (segment.empty())
+                continue;
+            r->starts.push_back(r->size);
+            r->segments.push_back(segment);
+            r->size += segment.size();
+        }
+        m_rope = std::move(r);
+    }
+
+    [[nodiscard]] bool ready() const { return m_rope != nullptr; }
+
+    [[nodiscard]] bool eof() const { return !(m_pos < size()); }
+
+    [[nodiscard]] char peek() const {
+        if (m_pos < size())
+            return m_rope->segments[m_segment][m_offset];
+        throw input_reader_exception("Trying to peek at rope_input_reader out of bounds.");
+    }
+
+    [[nodiscard]] char get() {
+        if (!(m_pos < size()))
+            throw input_reader_exception("Trying to get from rope_input_reader out of bounds.");
+        const char symbol = m_rope->segments[m_segment][m_offset];
+        ++m_pos;
+        if (++m_offset == m_rope->segments[m_segment].size()) {
+            ++m_segment;
+            m_offset = 0;
+        }
+        return symbol;
+    }
+
+    void seek(pos_type pos) {
+        m_pos = pos;
+        locate();
+    }
+
+    [[nodiscard]] pos_type tell() const { return m_pos; }
+
+    // The window is the rest of the current segment unless that is shorter than `n` -
+    // then the symbols from the next segments are copied after it.
+    [[nodiscard]] std::span<const char> window(std::size_t n) const {
+        if (!(m_pos < size()))
+            return {};
+
+        const auto segment = m_rope->segments[m_segment].subspan(m_offset);
+        if (!(segment.size() < n))
+            return segment;
+
+        const std::size_t count = std::min(n, size() - m_pos);
+        m_stitched.assign(segment.data(), segment.size());
+        for (std::size_t i = m_segment + 1; m_stitched.size() < count; ++i) {
+            const auto next = m_rope->segments[i];
+            m_stitched.append(next.data(), std::min(next.size(), count - m_stitched.size()));
+        }
+        return { m_stitched.data(), m_stitched.size() };
+    }
+
+    void advance(std::size_t count) {
+        m_pos += count;
+        // Moving within the current segment does not need a lookup.
+        if (m_segment < m_rope->segments.size() && m_offset + count < m_rope->segments[m_segment].size())
+            m_offset += count;
+        else
+            locate();
+    }
+
+    [[nodiscard]] std::size_t size() const noexcept { return m_rope->size; }
+
+    [[nodiscard]] std::size_t segments() const noexcept { return m_rope->segments.size(); }
+
+    [[nodiscard]] static const std::string &kind() noexcept {
+        static std::string kind = "rope_input_reader";
+        return kind;
+    }
+
+private:
+    // Finds the segment which `m_pos` falls in.
+    void locate() {
+        const auto &starts = m_rope->starts;
+        if (!(m_pos < size())) {
+            m_segment = starts.size();
+            m_offset = 0;
+            return;
+        }
+        m_segment = static_cast<std::size_t>(std::upper_bound(starts.begin(), starts.end(), m_pos) - starts.begin()) - 1;
+        m_offset = m_pos - starts[m_segment];
+    }
+
+    struct rope {
+        std::vector<std::span<const char>> segments;
+        // Where each of the segments starts in the whole input.
+        std::vector<pos_type> starts;
+        pos_type size{0};
+    };
+
+    std::shared_ptr<const rope> m_rope;
+
+    pos_type m_pos{0};
+    std::size_t m_segment{0};
+    std::size_t m_offset{0};
+
+    // The window when it spans more than a segment. It is mutable because of the `window()` method.
+    mutable std::string m_stitched;
+};
+
+///
+/// The `mmap_input_reader` class.
+/// This type implements using a file that is mapped read-only in memory as an
+/// input stream. All of the operations are served directly from the mapped pages,
+/// so there is neither a stream nor a copy of the contents involved. The mapping
+/// itself is shared between the copies of the reader, which makes copying it
+/// cheap - only the position is actually copied.
+///
+class mmap_input_reader final {
+public:
+    using pos_type = std::size_t;
+
+    explicit mmap_input_reader(const std::string &filename);
+
+    [[nodiscard]] bool ready() const { return m_mapping != nullptr; }
+
+    [[nodiscard]] bool eof() const { return !(m_pos < size()); }
+
+    [[nodiscard]] char peek() const {
+        if (m_pos < size())
+            return m_mapping->data[m_pos];
+        throw input_reader_exception("Trying to peek at mmap_input_reader out of bounds.");
+    }
+
+    [[nodiscard]] char get() {
+        if (m_pos < size())
+            return m_mapping->data[m_pos++];
+        throw input_reader_exception("Trying to get from mmap_input_reader out of bounds.");
+    }
+
+    void seek(pos_type pos) { m_pos = pos; }
+
+    [[nodiscard]] pos_type tell() const { return m_pos; }
+
+    [[nodiscard]] std::span<const char> window(std::size_t) const {
+        if (!(m_pos < size()))
+            return {};
+        return { m_mapping->data + m_pos, size() - m_pos };
+    }
+
+    void advance(std::size_t count) { m_pos += count; }
+
+    /// The whole mapped input. It stays valid for as long as any copy of the reader is alive.
+    [[nodiscard]] std::string_view view() const noexcept { return { m_mapping->data, m_mapping->size }; }
+
+    [[nodiscard]] std::shared_ptr<const void> keep_alive() const noexcept { return m_mapping; }
+
+    [[nodiscard]] std::size_t size() const noexcept { return m_mapping->size; }
+
+    [[nodiscard]] const std::string &filename() const noexcept { return m_mapping->filename; }
+
+    [[nodiscard]] static const std::string &kind() noexcept {
+        static std::string kind = "mmap_input_reader";
+        return kind;
+    }
+
+private:
+    // Owns the mapped region and unmaps it once the last reader referring to it is gone.
+    // Empty files cannot be mapped, so for them `data` is simply `nullptr`.
+    struct mapping {
+        ~mapping() noexcept;
+
+        std::string filename;
+        const char *data { nullptr };
+        std::size_t size { 0 };
+    };
+
+    std::shared_ptr<const mapping> m_mapping;
+    pos_type m_pos{0};
+};
+
+///
+/// The `sliding_window` class.
+/// A fixed-capacity buffer holding a window of some input that is read piece by
+/// piece, e.g. from a descriptor or a stream. The window only ever slides forward -
+/// whatever is before it is forgotten, so the memory it uses stays the same no
+/// matter how long the input is. It is the building block of the input reader
+/// strategies which do not have the whole input in memory.
+///
+class sliding_window {
+public:
+    using pos_type = std::size_t;
+
+    explicit sliding_window(std::size_t capacity)
+        : m_capacity{capacity} { }
+
+    // The contents are tied to a single source, so copying them makes no sense.
+    sliding_window(const sliding_window &) = delete;
+    sliding_window& operator=(const sliding_window &) = delete;
+
+    sliding_window(sliding_window &&) noexcept = default;
+    sliding_window& operator=(sliding_window &&) noexcept = default;
+
+    [[nodiscard]] std::size_t capacity() const noexcept { return m_capacity; }
+
+    [[nodiscard]] pos_type begin_pos() const noexcept { return m_begin; }
+    [[nodiscard]] pos_type end_pos() const noexcept { return m_begin + m_len; }
+
+    [[nodiscard]] bool contains(pos_type pos) const noexcept { return pos - m_begin < m_len; }
+
+    [[nodiscard]] std::size_t available(pos_type pos) const noexcept {
+        return contains(pos) ? m_len - (pos - m_begin) : 0;
+    }
+
+    [[nodiscard]] char at(pos_type pos) const noexcept { return m_data[pos - m_begin]; }
+
+    [[nodiscard]] std::span<const char> from(pos_type pos) const noexcept {
+        return { m_data.get() + (pos - m_begin), available(pos) };
+    }
+
+    /// Empties the window and makes it start at `pos`.
+    void reset(pos_type pos) noexcept {
+        m_begin = pos;
+        m_len = 0;
+    }
+
+    ///
+    /// Slides the window to start at `pos` and tops it up until it holds at least `n`
+    /// symbols (or is full) using `read_some(char *dest, std::size_t max)`. It returns
+    /// how many symbols it has written to `dest` and 0 once the input is over. Returns
+    /// false if there is nothing at `pos`.
+    ///
+    template <typename ReadSome>
+    bool slide(pos_type pos, std::size_t n, ReadSome &&read_some) {
+        // Safety: Everything before the window is gone, so the callers check that first.
+        assert(!(pos < m_begin));
+
+        if (!m_data)
+            m_data = std::make_unique<char[]>(m_capacity);
+        n = std::min(n, m_capacity);
+
+        // Sliding past the window means skipping over the input.
+        while (!(pos < end_pos())) {
+            reset(end_pos());
+            const std::size_t count = read_some(m_data.get(), m_capacity);
+            if (count == 0)
+                return false;
+            m_len = count;
+        }
+
+        // Move what is left to the front and top it up.
+        const std::size_t offset = pos - m_begin;
+        std::memmove(m_data.get(), m_data.get() + offset, m_len - offset);
+        m_begin = pos;
+        m_len -= offset;
+        while (m_len < n) {
+            const std::size_t count = read_some(m_data.get() + m_len, m_capacity - m_len);
+            if (count == 0)
+                break;
+            m_len += count;
+        }
+        return true;
+    }
+
+private:
+    std::size_t m_capacity;
+    std::unique_ptr<char[]> m_data;
+    pos_type m_begin{0};
+    std::size_t m_len{0};
+};
+
+///
+/// The `buf_input_reader` class.
+/// This type implements reading a file descriptor in large blocks into a buffer owned
+/// by the reader. The position is tracked with a plain integer, so reading a single
+/// symbol costs an index check instead of a call through the stream machinery. It
+/// works both on regular files and on pipes or FIFOs. The latter cannot be seeked,
+/// so on them the reader is only able to move forward and its end is unknown until
+/// it is reached. As only a block of the input is kept in memory at a time, reading
+/// a stream uses the same amount of memory no matter how long it is.
+/// The underlying descriptor is shared between the copies of the reader and each of
+/// them lazily gets a buffer of its own once it actually reads something.
+///
+class buf_input_reader final {
+public:
+    using pos_type = std::size_t;
+
+    static constexpr std::size_t default_block_size = 256 * 1024;
+
+    /// Opens the file and owns the descriptor.
+    explicit buf_input_reader(const std::string &filename, std::size_t block_size = default_block_size);
+
+    /// Uses an already opened descriptor (e.g. `STDIN_FILENO` or the read end of a pipe).
+    /// The descriptor is not closed by the reader.
+    explicit buf_input_reader(int fd, std::size_t block_size = default_block_size);
+
+    buf_input_reader(const buf_input_reader &rhs)
+        : m_source{rhs.m_source}
+        , m_window{rhs.m_window.capacity()}
+        , m_pos{rhs.m_pos} { }
+
+    buf_input_reader& operator=(const buf_input_reader &rhs) {
+        m_source = rhs.m_source;
+        m_window = sliding_window{rhs.m_window.capacity()};
+        m_pos = rhs.m_pos;
+        return *this;
+    }
+
+    buf_input_reader(buf_input_reader &&) noexcept = default;
+
+    buf_input_reader& operator=(buf_input_reader &&) noexcept = default;
+
+    [[nodiscard]] bool ready() const { return m_source != nullptr; }
+
+    [[nodiscard]] bool eof() const {
+        if (m_source->seekable)
+            return !(m_pos < m_source->size);
+        return !m_window.contains(m_pos) && !fill(1);
+    }
+
+    [[nodiscard]] char peek() const {
+        if (m_window.contains(m_pos) || fill(1))
+            return m_window.at(m_pos);
+        throw input_reader_exception("Trying to peek at buf_input_reader out of bounds.");
+    }
+
+    [[nodiscard]] char get() {
+        if (m_window.contains(m_pos) || fill(1))
+            return m_window.at(m_pos++);
+        throw input_reader_exception("Trying to get from buf_input_reader out of bounds.");
+    }
+
+    void seek(pos_type pos) { m_pos = pos; }
+
+    [[nodiscard]] pos_type tell() const { return m_pos; }
+
+    // The window is at most a block long.
+    [[nodiscard]] std::span<const char> window(std::size_t n) const {
+        if (m_window.available(m_pos) < std::min(n, block_size()) && !fill(n))
+            return {};
+        return m_window.from(m_pos);
+    }
+
+    void advance(std::size_t count) { m_pos += count; }
+
+    [[nodiscard]] std::size_t block_size() const noexcept { return m_window.capacity(); }
+
+    [[nodiscard]] bool seekable() const noexcept { return m_source->seekable; }
+
+    [[nodiscard]] static const std::string &kind() noexcept {
+        static std::string kind = "buf_input_reader";
+        return kind;
+    }
+
+private:
+    void attach(int fd, std::string name, bool owns_fd);
+
+    // Makes the window start at `m_pos` and hold at least `n` symbols (or a whole block,
+    // whichever is less) unless the input ends earlier. Returns false if there is nothing left.
+    bool fill(std::size_t n) const;
+
+    // The descriptor together with what is known about it. Pipes are consumed only once,
+    // so for them `stream_pos` remembers how far the shared descriptor has been read.
+    struct source {
+        ~source() noexcept;
+
+        std::string name;
+        int fd { -1 };
+        bool owns_fd { false };
+        bool seekable { false };
+        pos_type size { 0 };
+        pos_type stream_pos { 0 };
+    };
+
+    std::shared_ptr<source> m_source;
+
+    // The current block. It is mutable because of the `peek()`, `eof()` and `window()`
+    // methods, which may have to read it first.
+    mutable sliding_window m_window;
+
+    pos_type m_pos{0};
+};
+
+///
+/// The `stream_input_reader` class.
+/// This type implements reading from a `std::istream` that is owned by the caller,
+/// e.g. `std::cin` or a socket wrapped in a stream. Only a window of the input is
+/// kept in memory and it only ever moves forward, so the reader never seeks the
+/// stream and uses the same amount of memory regardless of the input's length.
+/// For reading a raw descriptor the same way see `buf_input_reader`.
+/// The stream is consumed as it is read, so the reader cannot be copied.
+///
+class stream_input_reader final {
+public:
+    using pos_type = std::size_t;
+
+    static constexpr std::size_t default_window_size = 64 * 1024;
+
+    explicit stream_input_reader(std::istream &is, std::size_t window_size = default_window_size)
+        : m_is{&is}
+        , m_window{window_size} {
+        if (!ready() || window_size == 0)
+            throw input_reader_exception{"Cannot use input stream of type `stream_input_reader`."};
+    }
+
+    stream_input_reader(const stream_input_reader &) = delete;
+    stream_input_reader& operator=(const stream_input_reader &) = delete;
+
+    stream_input_reader(stream_input_reader &&) noexcept = default;
+    stream_input_reader& operator=(stream_input_reader &&) noexcept = default;
+
+    [[nodiscard]] bool ready() const { return m_is != nullptr && !m_is->bad(); }
+
+    [[nodiscard]] bool eof() const { return !m_window.contains(m_pos) && !fill(1); }
+
+    [[nodiscard]] char peek() const {
+        if (m_window.contains(m_pos) || fill(1))
+            return m_window.at(m_pos);
+        throw input_reader_exception("Trying to peek at stream_input_reader out of bounds.");
+    }
+
+    [[nodiscard]] char get() {
+        if (m_window.contains(m_pos) || fill(1))
+            return m_window.at(m_pos++);
+        throw input_reader_exception("Trying to get from stream_input_reader out of bounds.");
+    }
+
+    // Seeking is lazy - it is checked once the input at the position is actually needed.
+    void seek(pos_type pos) { m_pos = pos; }
+
+    [[nodiscard]] pos_type tell() const { return m_pos; }
+
+    [[nodiscard]] std::span<const char> window(std::size_t n) const {
+        if (m_window.available(m_pos) < std::min(n, m_window.capacity()) && !fill(n))
+            return {};
+        return m_window.from(m_pos);
+    }
+
+    void advance(std::size_t count) { m_pos += count; }
+
+    [[nodiscard]] std::size_t window_size() const noexcept { return m_window.capacity(); }
+
+    [[nodiscard]] static const std::string &kind() noexcept {
+        static std::string kind = "stream_input_reader";
+        return kind;
+    }
+
+private:
+    bool fill(std::size_t n) const {
+        if (m_pos < m_window.begin_pos())
+            throw input_reader_exception("Cannot seek backwards in input of type `stream_input_reader`.");
+
+        return m_window.slide(m_pos, n, [this](char *dest, std::size_t max) -> std::size_t {
+            // Take whatever the stream has already buffered, but block for a single symbol
+            // at most - the input may be arriving piece by piece (e.g. through a pipe).
+            auto *buf = m_is->rdbuf();
+            const std::streamsize buffered = buf->in_avail();
+            if (buffered < 0)
+                return 0;
+            const auto want = std::min<std::streamsize>(std::max<std::streamsize>(buffered, 1), static_cast<std::streamsize>(max));
+            const std::streamsize count = buf->sgetn(dest, want);
+            if (count <= 0)
+                m_is->setstate(std::ios_base::eofbit);
+            return static_cast<std::size_t>(std::max<std::streamsize>(count, 0));
+        });
+    }
+
+    std::istream *m_is;
+
+    // It is mutable because of the `peek()`, `eof()` and `window()` methods,
+    // which may have to read it first.
+    mutable sliding_window m_window;
+
+    pos_type m_pos{0};
+};
+
+namespace detail {
+
+// These are defined in the source file, so that the threads and the codec libraries
+// do not leak into the users of the header.
+struct open_file;
+class prefetcher;
+
+}
+
+///
+/// The `compressed_input_reader` class.
+/// This type implements reading a compressed file as if it was a plain one. The codec
+/// is picked by the magic bytes at the start of the file - gzip (and zlib) is always
+/// supported and zstd is if the library was found when the project was configured.
+/// Anything else is read as is.
+/// The decompression runs on a background thread which keeps a couple of blocks ready
+/// ahead of the reader, so it overlaps with the tokenization. Only these blocks and a
+/// window of the decompressed input are kept in memory, so just like `stream_input_reader`
+/// the reader can only move forward and cannot be copied.
+///
+class compressed_input_reader final {
+public:
+    using pos_type = std::size_t;
+
+    static constexpr std::size_t default_window_size = 256 * 1024;
+
+    enum class codec { none, gzip, zstd };
+
+    explicit compressed_input_reader(const std::string &filename, std::size_t window_size = default_window_size);
+
+    ~compressed_input_reader() noexcept;
+
+    compressed_input_reader(const compressed_input_reader &) = delete;
+    compressed_input_reader& operator=(const compressed_input_reader &) = delete;
+
+    compressed_input_reader(compressed_input_reader &&) noexcept;
+    compressed_input_reader& operator=(compressed_input_reader &&) noexcept;
+
+    [[nodiscard]] bool ready() const { return m_prefetcher != nullptr; }
+
+    [[nodiscard]] bool eof() const { return !m_window.contains(m_pos) && !fill(1); }
+
+    [[nodiscard]] char peek() const {
+        if (m_window.contains(m_pos) || fill(1))
+            return m_window.at(m_pos);
+        throw input_reader_exception("Trying to peek at compressed_input_reader out of bounds.");
+    }
+
+    [[nodiscard]] char get() {
+        if (m_window.contains(m_pos) || fill(1))
+            return m_window.at(m_pos++);
+        throw input_reader_exception("Trying to get from compressed_input_reader out of bounds.");
+    }
+
+    void seek(pos_type pos) { m_pos = pos; }
+
+    [[nodiscard]] pos_type tell() const { return m_pos; }
+
+    [[nodiscard]] std::span<const char> window(std::size_t n) const {
+        if (m_window.available(m_pos) < std::min(n, m_window.capacity()) && !fill(n))
+            return {};
+        return m_window.from(m_pos);
+    }
+
+    void advance(std::size_t count) { m_pos += count; }
+
+    [[nodiscard]] codec compression() const noexcept { return m_codec; }
+
+    /// Whether the library was built with zstd support.
+    [[nodiscard]] static bool supports_zstd() noexcept;
+
+    [[nodiscard]] static const std::string &kind() noexcept {
+        static std::string kind = "compressed_input_reader";
+        return kind;
+    }
+
+private:
+    bool fill(std::size_t n) const;
+
+    // The size of the blocks the decompressed input is handed over in.
+    static constexpr std::size_t block_size = 128 * 1024;
+
+    std::unique_ptr<detail::prefetcher> m_prefetcher;
+    codec m_codec{codec::none};
+
+    // It is mutable because of the `peek()`, `eof()` and `window()` methods,
+    // which may have to decompress it first.
+    mutable sliding_window m_window;
+
+    pos_type m_pos{0};
+};
+
+///
+/// The `async_input_reader` class.
+/// This type implements reading a file on a background thread. While the tokenizer goes
+/// through one block, the next ones are being read (with the kernel's read-ahead hinted
+/// at as well), so waiting for the disk overlaps with the tokenization instead of adding
+/// up to it. This pays off for large files which are not in the page cache yet.
+/// Unlike the streams, the file can be read again, so seeking backwards works - it just
+/// starts the prefetching over. The copies share the file and each of them starts its
+/// own prefetching once it actually reads something.
+///
+class async_input_reader final {
+public:
+    using pos_type = std::size_t;
+
+    static constexpr std::size_t default_window_size = 256 * 1024;
+
+    explicit async_input_reader(const std::string &filename, std::size_t window_size = default_window_size);
+
+    async_input_reader(const async_input_reader &rhs);
+    async_input_reader& operator=(const async_input_reader &rhs);
+
+    ~async_input_reader() noexcept;
+
+    async_input_reader(async_input_reader &&) noexcept;
+    async_input_reader& operator=(async_input_reader &&) noexcept;
+
+    [[nodiscard]] bool ready() const { return m_file != nullptr; }
+
+    [[nodiscard]] bool eof() const { return !(m_pos < m_size); }
+
+    [[nodiscard]] char peek() const {
+        if (m_window.contains(m_pos) || fill(1))
+            return m_window.at(m_pos);
+        throw input_reader_exception("Trying to peek at async_input_reader out of bounds.");
+    }
+
+    [[nodiscard]] char get() {
+        if (m_window.contains(m_pos) || fill(1))
+            return m_window.at(m_pos++);
+        throw input_reader_exception("Trying to get from async_input_reader out of bounds.");
+    }
+
+    void seek(pos_type pos) { m_pos = pos; }
+
+    [[nodiscard]] pos_type tell() const { return m_pos; }
+
+    [[nodiscard]] std::span<const char> window(std::size_t n) const {
+        if (m_window.available(m_pos) < std::min(n, m_window.capacity()) && !fill(n))
+            return {};
+        return m_window.from(m_pos);
+    }
+
+    void advance(std::size_t count) { m_pos += count; }
+
+    [[nodiscard]] std::size_t size() const noexcept { return m_size; }
+
+    [[nodiscard]] static const std::string &kind() noexcept {
+        static std::string kind = "async_input_reader";
+        return kind;
+    }
+
+private:
+    bool fill(std::size_t n) const;
+
+    // Starts prefetching the file from `pos` on.
+    void restart(pos_type pos) const;
+
+    // The size of the blocks the file is read in.
+    static constexpr std::size_t block_size = 512 * 1024;
+
+    std::shared_ptr<const detail::open_file> m_file;
+    pos_type m_size{0};
+
+    // These are mutable because of the `peek()` and `window()` methods, which may have
+    // to wait for the next block first.
+    mutable std::unique_ptr<detail::prefetcher> m_prefetcher;
+    mutable sliding_window m_window;
+
+    pos_type m_pos{0};
+};
 
-static_assert(is_input_reader_v<str_input_reader>);
-static_assert(is_input_reader_v<ifs_input_reader>);
+static_assert(input_reader_strategy<ifs_input_reader>);
+static_assert(input_reader_strategy<str_input_reader>);
+static_assert(input_reader_strategy<view_input_reader>);
+static_assert(input_reader_strategy<rope_input_reader>);
+static_assert(input_reader_strategy<mmap_input_reader>);
+static_assert(input_reader_strategy<buf_input_reader>);
+static_assert(input_reader_strategy<stream_input_reader>);
+static_assert(input_reader_strategy<compressed_input_reader>);
+static_assert(input_reader_strategy<async_input_reader>);
+
+static_assert(stable_input_reader<str_input_reader>);
+static_assert(stable_input_reader<view_input_reader>);
+static_assert(stable_input_reader<mmap_input_reader>);
+static_assert(!stable_input_reader<buf_input_reader>);
 
 }
 
@@ -203,8 +203,30 @@ public:
         number(double data)
             : m_data{std::move(data)} {}
 
+        /// ...and from the integral ones, which it keeps exactly.
+        template <std::integral T>
+            requires (!std::same_as<T, bool>)
+        number(T data)
+            : m_data{make_integer(data)} {}
+
         operator double() const { return m_data.value(); }
 
+        /// Same as in `token_number`.
+        [[nodiscard]] token_number::kind representation() const noexcept { return m_data.representation(); }
+        [[nodiscard]] bool fits_int64() const noexcept { return m_data.fits_int64(); }
+        [[nodiscard]] bool fits_uint64() const noexcept { return m_data.fits_uint64(); }
+        [[nodiscard]] std::int64_t int64_value() const noexcept { return m_data.int64_value(); }
+        [[nodiscard]] std::uint64_t uint64_value() const noexcept { return m_data.uint64_value(); }
+
+    private:
+        template <std::integral T>
+        static token_number make_integer(T data) {
+            if constexpr (std::is_signed_v<T>)
+                return token_number{static_cast<std::int64_t>(data)};
+            else
+                return token_number{static_cast<std::uint64_t>(data)};
+        }
+
     private:
         /// Polymorphic comparator
         [[nodiscard]] bool equals(const value &rhs) const noexcept override {
@@ -244,7 +266,12 @@ public:
         string(const std::string& data)
             : m_data{std::move(data)} {}
 
-        explicit operator std::string() const { return m_data.value(); }
+        explicit operator std::string() const { return std::string{m_data.value()}; }
+
+        [[nodiscard]] std::string_view view() const noexcept { return m_data.value(); }
+
+        /// Whether the string refers to the parsed input instead of having its own copy.
+        [[nodiscard]] bool borrowed() const noexcept { return m_data.borrowed(); }
 
     private:
         /// Polymorphic comparator
@@ -286,7 +313,7 @@ public:
         /// `json::object`'s inner map container.
         struct hasher {
             size_t operator()(const json::string &s) const {
-                return std::hash<std::string>{}(s.m_data.value());
+                return std::hash<std::string_view>{}(s.m_data.value());
             }
         };
 
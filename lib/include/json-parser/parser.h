@@ -1,10 +1,14 @@
 #ifndef FMI_JSON_PARSER_PARSER_INCLUDED
 #define FMI_JSON_PARSER_PARSER_INCLUDED
 
+#include <expected>
+#include <thread>
+
 #include <mystd/optional.h>
 
 #include <json-parser/tokenizer.h>
 #include <json-parser/json.h>
+#include <json-parser/handler.h>
 #include <json-parser/input_reader.h>
 
 namespace json_parser {
@@ -33,6 +37,297 @@ private:
     std::string m_msg;
 };
 
+/// How deep the arrays and objects may be in one another, unless the parser is told otherwise.
+/// Deeper documents are rejected - the `json` itself is not ready for much more than that.
+inline constexpr std::size_t default_max_depth = 1024;
+
+/// Either the JSON or what went wrong (see `parser::try_parse()`).
+template <typename T>
+using parse_result = std::expected<T, parse_error>;
+
+///
+/// Builds the JSON out of a token tape (see `tokenizer::tape()`), going through it from
+/// start to end. Reports the same errors as the `parser` does.
+///
+[[nodiscard]] json parse_tape(const token_tape &tape, std::size_t max_depth = default_max_depth);
+
+namespace detail {
+
+///
+/// The `event_parser` class.
+/// The grammar of JSON - it goes through the tokens it is given and tells a handler what it
+/// finds (see `json_handler`). The `parser` gives it the tokens of its input as they come and
+/// `parse_tape()` gives it the ones on a tape, so the two accept the same documents and report
+/// the same errors.
+///
+/// It does not call itself for the arrays and objects in one another. Instead, the ones
+/// which are not closed yet are kept on `m_scopes` - so how deep they go is up to
+/// `m_max_depth` and not to how big the call stack is. Each value is parsed in two steps:
+/// first its beginning (which is all there is to the trivial ones), and once it is done,
+/// what comes after it - which may close the array or object it is in as well.
+///
+/// The tokens come from `Tokens`, which says whether there are none at all (`at_end()`) and
+/// whether there is any input left after the current one (`has_more()`), gives the current
+/// one (`current()`, null at the end or after an error) and moves on (`advance()`). It also
+/// tells what went wrong (`failed()`, `error()`) and where it is at (`where()`).
+///
+
+template <typename Tokens>
+class event_parser {
+public:
+    event_parser(Tokens &tokens, std::size_t max_depth)
+        : m_tokens{tokens}
+        , m_max_depth{max_depth} {}
+
+    [[nodiscard]] parse_error &error() noexcept { return m_error; }
+
+    /// Returns false if there is an error, which is then in `error()` - be it from the tokens
+    /// or from the grammar itself.
+    template <typename Handler>
+    [[nodiscard]] bool parse(Handler &handler) {
+        if (m_tokens.at_end())
+            return true;
+
+        // Most documents are not deep, so this is usually the only allocation for the stack.
+        m_scopes.clear();
+        m_scopes.reserve(std::min(m_max_depth, std::size_t{32}));
+        for (;;) {
+            bool done = false;
+            if (!begin_value(handler, done))
+                return false;
+            if (!done)
+                continue;
+
+            // The value is done - what comes after it tells whether the one it is in is too.
+            for (;;) {
+                if (m_scopes.empty())
+                    return true;
+                const char closing = m_scopes.back();
+                const char delimiter_sym = expect_punct();
+                if (!delimiter_sym)
+                    return false;
+                if (delimiter_sym == closing) {
+                    m_scopes.pop_back();
+                    if (closing == ']')
+                        handler.on_array_end();
+                    else
+                        handler.on_object_end();
+                    continue;
+                }
+                if (delimiter_sym != ',') {
+                    return fail(closing == ']' ? "Expected either ']' or ',' after value in JSON array."
+                                               : "Expected either '}' or ',' after key-value pair in JSON object.");
+                }
+                if (closing == '}' && !parse_key(handler))
+                    return false;
+                break;
+            }
+        }
+    }
+
+private:
+    // Parses a trivial value or opens an array or object - `done` is whether that is the whole
+    // value (i.e. it is not an array or object which is left open).
+    template <typename Handler>
+    [[nodiscard]] bool begin_value(Handler &handler, bool &done) {
+        if (!has_more())
+            return fail("Expected more tokens during parsing.");
+
+        // The token in the iterator should not be consumed before dispatching on it, because
+        // that would invalidate the expected "grammar" for arrays and objects.
+        token_value *next_tok_ptr = current_token();
+        if (!next_tok_ptr)
+            return m_error ? false : fail_end();
+        token_value &next_tok = *next_tok_ptr;
+
+        done = true;
+        switch (next_tok.type()) {
+        case token_value::kind::Punct: {
+            switch (next_tok.punct()) {
+            case '[': return begin_container(handler, ']', done);
+            case '{': return begin_container(handler, '}', done);
+            }
+
+            std::string msg = "Expected valid JSON value, but got an unexpected punctuator - '";
+            msg += next_tok.punct();
+            msg += "'";
+            return fail(std::move(msg));
+        }
+        // The "trivial" values are the only token of theirs, so they are consumed right away.
+        case token_value::kind::String:
+            handler.on_string(next_tok.string());
+            break;
+        case token_value::kind::Number:
+            handler.on_number(next_tok.number());
+            break;
+        case token_value::kind::Keyword:
+            if (next_tok.keyword() == token_keyword::kind::Null)
+                handler.on_null();
+            else
+                handler.on_bool(next_tok.keyword() == token_keyword::kind::True);
+            break;
+        }
+
+        return next_token();
+    }
+
+    // Safety: Called only when the opening bracket is found (and not yet consumed).
+    template <typename Handler>
+    [[nodiscard]] bool begin_container(Handler &handler, char closing, bool &done) {
+        if (m_scopes.size() >= m_max_depth)
+            return fail_too_deep();
+
+        const char opening = expect_punct();
+        if (!opening)
+            return false;
+        assert(opening == (closing == ']' ? '[' : '{'));
+        if (closing == ']')
+            handler.on_array_begin();
+        else
+            handler.on_object_begin();
+
+        if (const token_value *next_tok = current_token(); next_tok && next_tok->is_punct(closing)) {
+            if (closing == ']')
+                handler.on_array_end();
+            else
+                handler.on_object_end();
+            return next_token();
+        }
+        if (m_error)
+            return false;
+
+        done = false;
+        m_scopes.push_back(closing);
+        return closing == ']' || parse_key(handler);
+    }
+
+    // The key of an object member together with the ':' after it.
+    template <typename Handler>
+    [[nodiscard]] bool parse_key(Handler &handler) {
+        if (!has_more())
+            return fail("Expected more tokens during parsing.");
+
+        token_value *next_tok = current_token();
+        if (!next_tok)
+            return m_error ? false : fail_end();
+        switch (next_tok->type()) {
+        case token_value::kind::String:
+            handler.on_key(next_tok->string());
+            break;
+        case token_value::kind::Punct:
+            if (!next_tok->is_punct('[') && !next_tok->is_punct('{')) {
+                std::string msg = "Expected valid JSON value, but got an unexpected punctuator - '";
+                msg += next_tok->punct();
+                msg += "'";
+                return fail(std::move(msg));
+            }
+            // An array or object is not a key either - and there is no need to go through it
+            // in order to tell.
+            return fail("Expected string as key in JSON object");
+        default:
+            if (!next_token())
+                return false;
+            return fail("Expected string as key in JSON object");
+        }
+        if (!next_token())
+            return false;
+
+        const char separator_sym = expect_punct();
+        if (!separator_sym)
+            return false;
+        if (separator_sym != ':')
+            return fail("Expected ':' after key in JSON object.");
+        return true;
+    }
+
+    ///
+    /// Error handling and reporting helpers.
+    ///
+
+    [[nodiscard]] bool has_more() const noexcept { return m_tokens.has_more(); }
+
+    // The current token, or null if there is none - at the end or after an error (which is
+    // then in `m_error`).
+    [[nodiscard]] token_value *current_token() {
+        token_value *tok = m_tokens.current();
+        if (!tok && m_tokens.failed())
+            m_error = m_tokens.error();
+        return tok;
+    }
+
+    [[nodiscard]] bool next_token() {
+        if (m_tokens.advance())
+            return true;
+        m_error = m_tokens.error();
+        return false;
+    }
+
+    // Consumes the next token, which has to be a punctuator, and returns which one it is.
+    // Returns '\0' if there is an error.
+    char expect_punct() {
+        const token_value *next_token_ptr = current_token();
+        if (!next_token_ptr) {
+            if (!m_error)
+                fail_end();
+            return '\0';
+        }
+        if (next_token_ptr->type() != token_value::kind::Punct) {
+            fail(std::string("Expected token of type `") + typeid(token_punct).name() + "` but no such was found.");
+            return '\0';
+        }
+        const char sym = next_token_ptr->punct();
+        return next_token() ? sym : '\0';
+    }
+
+    // These keep what went wrong and return false, so that it can be returned.
+    bool fail(std::string msg) {
+        m_error = parse_error{parse_errc::syntax, m_tokens.where(), std::move(msg)};
+        return false;
+    }
+
+    bool fail_too_deep() {
+        m_error = parse_error{parse_errc::too_deep, m_tokens.where(),
+                              "More than " + std::to_string(m_max_depth) + " arrays and objects in one another."};
+        return false;
+    }
+
+    // The tokens are over, while the parser expects more.
+    bool fail_end() {
+        m_error = parse_error{parse_errc::unexpected_end, m_tokens.where(), "Trying to access consumed token."};
+        return false;
+    }
+
+private:
+    Tokens &m_tokens;
+    parse_error m_error;
+
+    // The arrays and objects which are not closed yet, the innermost one last - as the bracket
+    // which closes them.
+    std::vector<char> m_scopes;
+    std::size_t m_max_depth;
+};
+
+// The tokens as the token iterator of a `parser` gives them.
+template <typename TokenIterator>
+class iterator_tokens {
+public:
+    explicit iterator_tokens(TokenIterator &it) noexcept
+        : m_it{it} {}
+
+    [[nodiscard]] bool at_end() const noexcept { return m_it == token_sentinel{}; }
+    [[nodiscard]] bool has_more() const noexcept { return m_it.has_more(); }
+    [[nodiscard]] token_value *current() { return m_it.try_get(); }
+    [[nodiscard]] bool advance() { return m_it.try_advance(); }
+    [[nodiscard]] bool failed() const noexcept { return m_it.failed(); }
+    [[nodiscard]] const parse_error &error() const noexcept { return m_it.error(); }
+    [[nodiscard]] location where() const { return m_it.current_location(); }
+
+private:
+    TokenIterator &m_it;
+};
+
+}
+
 ///
 /// The `parser` class.
 /// This type implements the logic of the parsing process. It uses the
@@ -42,7 +337,7 @@ private:
 ///
 
 template <typename InputReaderConcrete>
-    requires is_input_reader_v<InputReaderConcrete>
+    requires input_reader_strategy<InputReaderConcrete>
 class parser final {
     using input_reader_type = InputReaderConcrete;
     using tokenizer_type = tokenizer<input_reader_type>;
@@ -53,27 +348,36 @@ public:
     /// Special member functions.
     ///
 
-    explicit parser(input_reader_type&& ir)
+    explicit parser(input_reader_type&& ir, std::size_t max_depth = default_max_depth)
         try : m_tokenizer{std::move(ir)}
             , m_token_cit{m_tokenizer.begin()}
+            , m_source{source_of(m_tokenizer.input_reader())}
+            , m_max_depth{max_depth}
     { } catch (const token_exception &te) {
         throw parser_exception(te.what());
     }
 
-    explicit parser(const input_reader_type& ir)
+    explicit parser(const input_reader_type& ir, std::size_t max_depth = default_max_depth)
         try : m_tokenizer{ir}
             , m_token_cit{m_tokenizer.begin()}
+            , m_source{source_of(m_tokenizer.input_reader())}
+            , m_max_depth{max_depth}
     { } catch (const token_exception &te) {
         throw parser_exception(te.what());
     }
 
+    // The token iterator refers to the input reader owned by `m_tokenizer`.
+    parser(const parser &) = delete;
+    parser& operator=(const parser &) = delete;
+
 public:
     ///
     /// Parsing behaviour.
     ///
     /// The parsing process is started by the `parse()` function or the `operator()`.
-    /// The dirty work is performed in the `parse_*()` family of functions. They are
-    /// private as they aren't of big interest to the end-user.
+    /// The dirty work is performed in `parse_events()` (by `detail::event_parser`), which is
+    /// private as it isn't of big interest to the end-user. It tells a handler (see
+    /// `json_handler`) what it finds and building the `json` is up to the handler - `dom_builder`.
     ///
 
     const json &parse() & {
@@ -94,172 +398,117 @@ public:
 
     json operator()() && { return parse(); }
 
-private:
-
-    void parse_and_store() {
-        const auto token_end = m_tokenizer.end();
+    /// Same as `parse()`, but what went wrong is returned instead of thrown.
+    parse_result<json> try_parse() && {
+        if (m_parsed)
+            return std::move(*this).parse();
 
-        if (m_token_cit == token_end) {
-            m_parsed.emplace();
-            return;
-        }
+        dom_builder builder = make_dom_builder();
+        if (auto result = std::move(*this).try_parse(builder); !result)
+            return std::unexpected{std::move(result.error())};
+        return builder.take();
+    }
 
+    /// Instead of building the JSON, tells `handler` what is in it as it goes (see
+    /// `json_handler`). Only as much is kept in memory as it takes to know which arrays
+    /// and objects are not closed yet.
+    template <json_handler Handler>
+    void parse(Handler &handler) && {
+        bool parsed = false;
         try {
-            auto root_node = parse_value();
-            m_parsed.emplace(json{std::move(root_node)});
+            parsed = parse_events(handler);
         } catch (const token_exception &t) {
             // The tokenizer is too low-level to be reasonable
             // to report errors using its name :).
             throw parser_exception(t.what());
         }
+        if (!parsed)
+            throw parser_exception(m_error.message, m_error.where);
     }
 
-    [[nodiscard]] json::pmrvalue parse_object() {
-        mystd::unique_ptr<token> object_begin = expect_token<token_punct>();
-        // Safety: parse_object() is called only when '{' is found.
-        // Also, on entering this function the '{' token is not yet consumed.
-        assert(token_as<token_punct>(object_begin)->value() == '{');
-
-        json::pmrvalue node = json::make_node<json::object>();
-        json::object &node_as_object = dynamic_cast<json::object &>(*node.get());
-
-        const token *next_tok_ptr = m_token_cit.peek_unsafe();
-        const auto *next_tok_ptr_as_punct = token_as<token_punct>(next_tok_ptr);
-        if (next_tok_ptr_as_punct && next_tok_ptr_as_punct->value() == '}') {
-            ++m_token_cit;
-            return node;
-        }
-
-        for (;;) {
-            json::string key_as_str = [&]() {
-                json::pmrvalue key = parse_value();
-                auto *key_as_str_ptr = dynamic_cast<json::string *>(key.get());
-                if (!key_as_str_ptr)
-                    throw parser_exception_here("Expected string as key in JSON object");
-                return *key_as_str_ptr;
-            }();
-
-            mystd::unique_ptr<token> column = expect_token<token_punct>();
-            if (token_as<token_punct>(column)->value() != ':')
-                throw parser_exception_here("Expected ':' after key in JSON object.");
-
-            json::pmrvalue val = parse_value();
-            node_as_object.append(std::move(key_as_str), std::move(val));
-
-            mystd::unique_ptr<token> delimiter = expect_token<token_punct>();
-            const char delimiter_sym = token_as<token_punct>(delimiter)->value();
-            if (delimiter_sym == '}')
-                break;
-            if (delimiter_sym != ',')
-                throw parser_exception_here("Expected either '}' or ',' after key-value pair in JSON object.");
+    /// Same as `parse(handler)`, but what went wrong is returned instead of thrown. The
+    /// handler is told everything up to the error.
+    template <json_handler Handler>
+    parse_result<void> try_parse(Handler &handler) && {
+        try {
+            if (!parse_events(handler))
+                return std::unexpected{std::move(m_error)};
+        } catch (const token_exception &t) {
+            // Only the input reader failing to read the input is still thrown - that is rare
+            // enough not to be worth a way around it.
+            return std::unexpected{parse_error{parse_errc::input, m_token_cit.current_location(), t.what()}};
         }
-
-        return node;
+        return {};
     }
 
-    [[nodiscard]] json::pmrvalue parse_array() {
-        mystd::unique_ptr<token> array_begin = expect_token<token_punct>();
-        // Safety: parse_array() is called only when '[' is found.
-        // Also, on entering this function the '[' token is not yet consumed.
-        assert(token_as<token_punct>(array_begin)->value() == '[');
-
-        json::pmrvalue node = json::make_node<json::array>();
-        json::array &node_as_array = dynamic_cast<json::array &>(*node.get());
-
-        const token *next_tok_ptr = m_token_cit.peek_unsafe();
-        const auto *next_tok_ptr_as_punct = token_as<token_punct>(next_tok_ptr);
-        if (next_tok_ptr_as_punct && next_tok_ptr_as_punct->value() == ']') {
-            ++m_token_cit;
-            return node;
-        }
+    /// Same as `parse()`, but in two passes - all of the tokens are put on a `token_tape`
+    /// first and the JSON is built out of the tape after that. The tape holds the tokens up
+    /// to the first one which is not valid, so that a syntax error before it still wins.
+    json parse_via_tape() && {
+        if (m_parsed)
+            return std::move(*this).parse();
 
-        for (;;) {
-            node_as_array.append(parse_value());
-            mystd::unique_ptr<token> delimiter = expect_token<token_punct>();
-            const char delimiter_sym = token_as<token_punct>(delimiter)->value();
-            if (delimiter_sym == ']')
-                break;
-            if (delimiter_sym != ',')
-                throw parser_exception_here("Expected either ']' or ',' after value in JSON array.");
+        token_tape tape;
+        try {
+            tape = m_tokenizer.tape(m_token_cit);
+        } catch (const token_exception &t) {
+            throw parser_exception(t.what());
         }
-
-        return node;
+        return parse_tape(tape, m_max_depth);
     }
 
-    [[nodiscard]] json::pmrvalue parse_value() {
-        // Safety: If parse_value() was called then there has to be a value, otherwise it
-        // wouldn't be called in the first place. That is guaranteed by the called.
-        expect_has_more();
-
-        // Try parsing an array or an object.
-        // The token in the iterator should not be consumed here, because that would
-        // invalidate the expected "grammar" in parse_array() and parse_object().
-        // Safety:
-        const token *next_tok_ptr = m_token_cit.peek_unsafe();
-        assert(next_tok_ptr != nullptr);
-
-        if (auto *punct = token_as<token_punct>(next_tok_ptr); punct != nullptr) {
-            switch (punct->value()) {
-            case '[': return parse_array();
-            case '{': return parse_object();
-            }
-
-            std::string msg = "Expected valid JSON value, but got an unexpected punctuator - '";
-            msg += punct->value();
-            msg += "'";
-            throw parser_exception_here(std::move(msg));
-        }
-
-        // Try parsing a "trivial" value.
-        // Here we can safely consume the next token as it is the only one.
-        auto next_tok = *m_token_cit;
-        next_tok_ptr = next_tok.get();
-
-        json::pmrvalue next_node;
-        if (auto *str = token_as<token_string>(next_tok_ptr); str != nullptr)
-            next_node = json::make_node<json::string>(*str);
-        else if (auto *num = token_as<token_number>(next_tok_ptr); num != nullptr)
-            next_node = json::make_node<json::number>(*num);
-        else if (auto *kw = token_as<token_keyword>(next_tok_ptr); kw != nullptr){
-            if (kw->value() == token_keyword::kind::Null)
-                next_node = json::make_node<json::null>();
-            else
-                next_node = json::make_node<json::boolean>(*kw);
-        }
+    /// Same as `parse_via_tape()`, but the tape is filled by `threads` threads at once (see
+    /// `parallel_tape()`). Only for the input readers which have the whole input in memory.
+    json parse_via_parallel_tape(std::size_t threads = std::thread::hardware_concurrency()) &&
+        requires stable_input_reader<input_reader_type>
+    {
+        if (m_parsed)
+            return std::move(*this).parse();
 
-        if (next_node) {
-            ++m_token_cit;
-            return next_node;
+        token_tape tape;
+        try {
+            tape = parallel_tape(m_tokenizer.input_reader().view(), threads);
+        } catch (const token_exception &t) {
+            throw parser_exception(t.what());
         }
-
-        // We tried parsing whatever we could. Now fail successfully.
-        throw parser_exception_here("Expected valid JSON value, but no such was found.");
+        return parse_tape(tape, m_max_depth);
     }
 
 private:
-    ///
-    /// Error handling and reporting helpers.
-    ///
 
-    [[nodiscard]] bool has_more() const noexcept { return m_token_cit.has_more(); }
+    // Whatever keeps the input alive, so that the strings in the JSON may refer to it.
+    // Empty if they have to be copied out of it.
+    static std::shared_ptr<const void> source_of(const input_reader_type &ir) {
+        if constexpr (stable_input_reader<input_reader_type>)
+            return ir.keep_alive();
+        else
+            return {};
+    }
 
-    void expect_has_more() const {
-        if (!m_token_cit.has_more())
-            throw parser_exception_here("Expected more tokens during parsing.");
+    // The strings which are in the input as they are may refer to it, if it is kept alive.
+    dom_builder make_dom_builder() const {
+        if constexpr (stable_input_reader<input_reader_type>)
+            return dom_builder{m_source, m_tokenizer.input_reader().view()};
+        else
+            return dom_builder{};
     }
 
-    template <typename TokenKind>
-    mystd::unique_ptr<token> expect_token() {
-//        expect_has_more();
-        mystd::unique_ptr<token> next_token = *m_token_cit++;
-        if (!token_as<TokenKind>(next_token))
-            throw parser_exception_here(std::string("Expected token of type `") + typeid(TokenKind).name() + "` but no such was found.");
-        return next_token;
+    void parse_and_store() {
+        dom_builder builder = make_dom_builder();
+        std::move(*this).parse(builder);
+        m_parsed.emplace(builder.take());
     }
 
-    template <typename T>
-    [[nodiscard]] parser_exception parser_exception_here(T&& msg) const {
-        return parser_exception(mystd::forward<T>(msg), m_token_cit.current_location());
+    // Goes through the tokens of the input (see `detail::event_parser`). Returns false if
+    // there is an error, which is then kept in `m_error`.
+    template <typename Handler>
+    [[nodiscard]] bool parse_events(Handler &handler) {
+        detail::iterator_tokens tokens{m_token_cit};
+        detail::event_parser events{tokens, m_max_depth};
+        if (events.parse(handler))
+            return true;
+        m_error = std::move(events.error());
+        return false;
     }
 
 public:
@@ -278,12 +527,22 @@ public:
 private:
     tokenizer_type m_tokenizer;
     token_iterator_type m_token_cit;
+    std::shared_ptr<const void> m_source;
 	mystd::optional<json> m_parsed;
+    parse_error m_error;
+    std::size_t m_max_depth;
 };
 
 /// Aliases
 using ifs_parser = parser<ifs_input_reader>;
 using str_parser = parser<str_input_reader>;
+using view_parser = parser<view_input_reader>;
+using rope_parser = parser<rope_input_reader>;
+using mmap_parser = parser<mmap_input_reader>;
+using buf_parser = parser<buf_input_reader>;
+using stream_parser = parser<stream_input_reader>;
+using compressed_parser = parser<compressed_input_reader>;
+using async_parser = parser<async_input_reader>;
 
 }
 
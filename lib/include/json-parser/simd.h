@@ -0,0 +1,85 @@
+#ifndef FMI_JSON_PARSER_SIMD_INCLUDED
+#define FMI_JSON_PARSER_SIMD_INCLUDED
+
+#include <span>
+#include <vector>
+#include <cstdint>
+
+namespace json_parser::simd {
+
+///
+/// The SIMD kernels.
+/// These are the hot loops of the tokenizer which go through the input 64 bytes at a time
+/// instead of a symbol at a time. Each of them comes in a couple of flavours - one for
+/// every instruction set below. The best one which the CPU supports is picked the first
+/// time a kernel is used. There is always the scalar one to fall back to.
+///
+
+enum class isa {
+    scalar,
+    sse42,
+    avx2
+};
+
+/// The instruction set whose kernels are currently used.
+[[nodiscard]] isa active_isa() noexcept;
+
+/// Makes the kernels for `which` the used ones. Returns false (and changes nothing) if the
+/// CPU does not support it. Mostly useful for testing and benchmarking the different kernels.
+bool select_isa(isa which) noexcept;
+
+[[nodiscard]] const char *isa_name(isa which) noexcept;
+
+///
+/// The structural index (a.k.a. "stage 1").
+/// Appends to `positions` where each of the tokens in `input` starts - these are the
+/// punctuators `{}[]:,`, the opening quotes of strings and the first symbols of numbers
+/// and keywords. Everything inside the strings is skipped, taking the escape sequences
+/// into account. The positions are relative to the start of `input`, which is expected
+/// to be between two tokens (i.e. not inside a string).
+///
+void index_structurals(std::span<const char> input, std::vector<std::uint32_t> &positions);
+
+///
+/// The same, also appending to `line_breaks` where the '\n', '\r' and '\t' symbols outside
+/// of the strings are - these are the ones which move the location to another line or
+/// column in a special way. The kind of the symbol is kept in the top two bits of each
+/// position (see `line_break`), so `input` has to be shorter than 1 GiB.
+///
+enum class line_break : std::uint32_t {
+    newline = 0,
+    carriage_return = 1,
+    tab = 2
+};
+
+constexpr int line_break_shift = 30;
+constexpr std::uint32_t line_break_position_mask = (std::uint32_t{1} << line_break_shift) - 1;
+
+void index_structurals(std::span<const char> input, std::vector<std::uint32_t> &positions,
+                       std::vector<std::uint32_t> &line_breaks);
+
+///
+/// Whitespace skipping.
+/// Finds how long the run of whitespace at the start of `input` is, looking at no more than
+/// `max` symbols. Everything after those may still be read (though not taken into account),
+/// so passing the whole input available lets the kernel use full blocks.
+///
+[[nodiscard]] std::size_t scan_whitespace(std::span<const char> input, std::size_t max);
+
+///
+/// String scanning.
+/// Finds the first '"' or '\\' in `input` - i.e. where the plain run of symbols in a string
+/// body ends. Returns `input.size()` if there is neither.
+///
+[[nodiscard]] std::size_t scan_string(std::span<const char> input);
+
+///
+/// UTF-8 validation.
+/// Tells whether `input` is valid UTF-8 - no overlong or surrogate sequences, nothing past
+/// U+10FFFF and no sequence cut short at the end.
+///
+[[nodiscard]] bool validate_utf8(std::span<const char> input);
+
+}
+
+#endif // FMI_JSON_PARSER_SIMD_INCLUDED
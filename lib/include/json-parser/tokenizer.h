@@ -1,16 +1,25 @@
 #ifndef FMI_JSON_PARSER_TOKENIZER_INCLUDED
 #define FMI_JSON_PARSER_TOKENIZER_INCLUDED
 
+#include <span>
+#include <array>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <vector>
 #include <cstring>
 #include <fstream>
 #include <iostream>
 #include <string>
+#include <string_view>
+#include <variant>
 
 #include <mystd/memory.h>
 #include <mystd/optional.h>
 #include <mystd/utility.h>
 
 #include <json-parser/input_reader.h>
+#include <json-parser/simd.h>
 
 namespace json_parser {
 
@@ -102,6 +111,35 @@ private:
 	std::string m_msg;
 };
 
+///
+/// The `parse_error` type.
+/// What went wrong, for the functions which return it instead of throwing - unwinding for
+/// every bad input adds up when most of the inputs are bad. The message is the same as the
+/// one of the exception which would be thrown otherwise.
+///
+
+enum class parse_errc {
+    none,
+    unexpected_symbol,
+    unexpected_end,
+    invalid_utf8,
+    unpaired_surrogate,
+    // The tokens are fine, but they do not make up a JSON (e.g. a missing comma).
+    syntax,
+    // The arrays and objects are in one another deeper than allowed.
+    too_deep,
+    // The input reader could not read the input.
+    input,
+};
+
+struct parse_error {
+    parse_errc code{parse_errc::none};
+    location where{0};
+    std::string message;
+
+    [[nodiscard]] explicit operator bool() const noexcept { return code != parse_errc::none; }
+};
+
 ///
 /// The token type hierarchy.
 /// There is base class `token` - it holds no data.
@@ -127,6 +165,11 @@ struct token {
     virtual mystd::unique_ptr<token> clone() const noexcept = 0;
 };
 
+///
+/// A string either has its own copy of the value or refers to the input it was read from
+/// (see `stable_input_reader`) - then it also holds on to whatever keeps the input alive.
+///
+
 class token_string final : public token {
 public:
 	explicit token_string(const std::string& value)
@@ -134,45 +177,120 @@ public:
 	{
     }
 
+    explicit token_string(std::string&& value)
+        : m_value { std::move(value) }
+    {
+    }
+
+    token_string(std::string_view value, std::shared_ptr<const void> source)
+        : m_value { borrowed_string{ value, std::move(source) } }
+    {
+    }
+
 private:
     bool equals(const token &rhs) const noexcept override {
         const token_string* rhs_as_string = dynamic_cast<const token_string*>(&rhs);
         if(rhs_as_string == nullptr)
             return false;
-        return token::equals(rhs) && m_value == rhs_as_string->m_value;
+        return token::equals(rhs) && value() == rhs_as_string->value();
     }
 
 public:
-	[[nodiscard]] const std::string& value() const noexcept { return m_value; }
+	[[nodiscard]] std::string_view value() const noexcept {
+        if (const auto *borrowed = std::get_if<borrowed_string>(&m_value))
+            return borrowed->value;
+        return std::get<std::string>(m_value);
+    }
+
+    [[nodiscard]] bool borrowed() const noexcept { return std::holds_alternative<borrowed_string>(m_value); }
 
     void serialize(std::ostream &os) const override;
 
     mystd::unique_ptr<token> clone() const noexcept override { return mystd::make_unique<token_string>(*this); }
 
 private:
-	std::string m_value;
+    struct borrowed_string {
+        std::string_view value;
+        std::shared_ptr<const void> source;
+    };
+
+	std::variant<std::string, borrowed_string> m_value;
 };
 
+///
+/// Numbers without a fraction or an exponent are kept as exact 64-bit integers (as long as
+/// they fit), everything else is a double. `value()` is the number as a double whatever it
+/// is kept as, and the `fits_*()`/`*_value()` pairs give the exact integer (if the number is
+/// an integer which fits - even one kept as a double).
+///
+
 class token_number final : public token {
 public:
+    enum class kind {
+        Double,
+        Int64,
+        Uint64
+    };
+
 	explicit token_number(double value)
-		: m_value { value }
+		: m_kind { kind::Double }
+		, m_double { value }
 	{
     }
 
-	[[nodiscard]] double value() const noexcept { return m_value; }
+    explicit token_number(std::int64_t value)
+        : m_kind { kind::Int64 }
+        , m_int64 { value }
+    {
+    }
+
+    explicit token_number(std::uint64_t value)
+        : m_kind { kind::Uint64 }
+        , m_uint64 { value }
+    {
+    }
+
+private:
+    bool equals(const token &rhs) const noexcept override;
+
+public:
+    [[nodiscard]] kind representation() const noexcept { return m_kind; }
+
+	[[nodiscard]] double value() const noexcept {
+        switch (m_kind) {
+        case kind::Int64:
+            return static_cast<double>(m_int64);
+        case kind::Uint64:
+            return static_cast<double>(m_uint64);
+        default:
+            return m_double;
+        }
+    }
+
+    [[nodiscard]] bool fits_int64() const noexcept;
+    [[nodiscard]] bool fits_uint64() const noexcept;
+
+    /// Only when `fits_int64()`.
+    [[nodiscard]] std::int64_t int64_value() const noexcept;
+    /// Only when `fits_uint64()`.
+    [[nodiscard]] std::uint64_t uint64_value() const noexcept;
 
     void serialize(std::ostream &os) const override;
 
     mystd::unique_ptr<token> clone() const noexcept override { return mystd::make_unique<token_number>(*this); }
 
 private:
-	double m_value;
+    kind m_kind;
+    union {
+        double m_double;
+        std::int64_t m_int64;
+        std::uint64_t m_uint64;
+    };
 };
 
 class token_keyword final : public token {
 public:
-    enum class kind {
+    enum class kind : std::uint8_t {
         True,
         False,
         Null
@@ -232,6 +350,185 @@ private:
 	char m_value;
 };
 
+///
+/// The `token_value` class.
+/// This is what the token iterator actually holds - a kind tag and the data for it, kept by
+/// value. The punctuators, keywords and numbers never touch the heap this way and the
+/// string's buffer is reused from one token to the next, so going through the tokens does
+/// not allocate (which the `token` hierarchy above did for every single `,`). Users switch
+/// on `type()` instead of `dynamic_cast`-ing; `to_token()` gives the polymorphic version.
+///
+
+class token_value {
+public:
+    enum class kind : std::uint8_t {
+        Punct,
+        Keyword,
+        Number,
+        String
+    };
+
+    [[nodiscard]] kind type() const noexcept { return m_kind; }
+
+    /// The accessors expect the token to be of the right kind.
+    [[nodiscard]] char punct() const noexcept { return m_punct; }
+    [[nodiscard]] token_keyword::kind keyword() const noexcept { return m_keyword; }
+    [[nodiscard]] const token_number &number() const noexcept { return m_number; }
+    [[nodiscard]] std::string_view string() const noexcept { return m_borrowed ? m_borrowed_string : m_string; }
+
+    /// Whether the string refers to the input instead of being copied out of it.
+    [[nodiscard]] bool borrowed() const noexcept { return m_borrowed; }
+
+    /// Moves the copy of the string out (or makes one, if it is borrowed).
+    [[nodiscard]] std::string take_string() {
+        if (m_borrowed)
+            return std::string{m_borrowed_string};
+        return std::move(m_string);
+    }
+
+    [[nodiscard]] bool is_punct(char sym) const noexcept { return m_kind == kind::Punct && m_punct == sym; }
+
+    void set_punct(char sym) noexcept {
+        m_kind = kind::Punct;
+        m_punct = sym;
+    }
+
+    void set_keyword(token_keyword::kind keyword) noexcept {
+        m_kind = kind::Keyword;
+        m_keyword = keyword;
+    }
+
+    void set_number(const token_number &number) noexcept {
+        m_kind = kind::Number;
+        m_number = number;
+    }
+
+    // Returns the (emptied) string to fill in, keeping whatever it has allocated so far.
+    [[nodiscard]] std::string &set_string() noexcept {
+        m_kind = kind::String;
+        m_borrowed = false;
+        m_string.clear();
+        return m_string;
+    }
+
+    void set_borrowed_string(std::string_view value) noexcept {
+        m_kind = kind::String;
+        m_borrowed = true;
+        m_borrowed_string = value;
+    }
+
+    friend bool operator==(const token_value &lhs, const token_value &rhs) noexcept;
+
+    void serialize(std::ostream &os) const;
+
+    [[nodiscard]] mystd::unique_ptr<token> to_token() const;
+
+private:
+    kind m_kind{kind::Punct};
+    char m_punct{0};
+    token_keyword::kind m_keyword{token_keyword::kind::Null};
+    token_number m_number{0.0};
+    bool m_borrowed{false};
+    std::string_view m_borrowed_string;
+    std::string m_string;
+};
+
+///
+/// The `token_tape` class.
+/// All of the tokens of a document laid out one after another in a single array (see
+/// `tokenizer::tape()`). Besides the token itself, each entry knows where it is in the
+/// input and the brackets know where their pair is, so a whole array or object can be
+/// skipped at once. The numbers and the strings are kept on the side, in one place each.
+///
+/// If the input is not valid, the tape holds the tokens before the error and the error
+/// itself (see `failed()`) - so that whoever goes through it finds the error where it is
+/// in the input, and not before the tokens preceding it.
+///
+
+struct tape_entry {
+    token_value::kind kind{token_value::kind::Punct};
+    char punct{0};
+    token_keyword::kind keyword{token_keyword::kind::Null};
+
+    // Where the token is in the input.
+    std::size_t offset{0};
+    std::size_t length{0};
+
+    union {
+        // For the brackets - the index of the other one of the pair (`token_tape::npos` if
+        // there is none, i.e. the input is not valid JSON).
+        std::size_t match{static_cast<std::size_t>(-1)};
+        // For the numbers - which one they are, for the strings - where their value starts.
+        std::size_t value;
+    };
+    std::size_t value_length{0};
+};
+
+class token_tape {
+public:
+    static constexpr std::size_t npos = static_cast<std::size_t>(-1);
+
+    [[nodiscard]] std::size_t size() const noexcept { return m_entries.size(); }
+    [[nodiscard]] bool empty() const noexcept { return m_entries.empty(); }
+
+    [[nodiscard]] const tape_entry &operator[](std::size_t i) const noexcept { return m_entries[i]; }
+
+    [[nodiscard]] auto begin() const noexcept { return m_entries.begin(); }
+    [[nodiscard]] auto end() const noexcept { return m_entries.end(); }
+
+    [[nodiscard]] std::string_view string(const tape_entry &entry) const noexcept {
+        return std::string_view{m_strings}.substr(entry.value, entry.value_length);
+    }
+
+    [[nodiscard]] const token_number &number(const tape_entry &entry) const noexcept {
+        return m_numbers[entry.value];
+    }
+
+    /// The index right after the value which starts at `i` - for arrays and objects that is
+    /// right after their closing bracket. Returns `size()` if the value is not closed.
+    [[nodiscard]] std::size_t skip(std::size_t i) const noexcept;
+
+    /// Puts the next token at the end of the tape.
+    void append(const token_value &token, std::size_t offset, std::size_t length);
+
+    /// Where the input ends - which is after the last token and the whitespace after it.
+    [[nodiscard]] std::size_t input_end() const noexcept { return m_input_end; }
+    void set_input_end(std::size_t input_end) noexcept { m_input_end = input_end; }
+
+    /// Whether the tokens after the last one on the tape are not valid - and why.
+    [[nodiscard]] bool failed() const noexcept { return static_cast<bool>(m_error); }
+    [[nodiscard]] const parse_error &error() const noexcept { return m_error; }
+    void set_error(parse_error error) { m_error = std::move(error); }
+
+private:
+    friend token_tape parallel_tape(std::string_view input, std::size_t threads);
+
+    std::vector<tape_entry> m_entries;
+    std::vector<token_number> m_numbers;
+    std::string m_strings;
+    std::size_t m_input_end{0};
+    parse_error m_error;
+
+    // The brackets which are not yet closed while the tape is being filled.
+    std::vector<std::size_t> m_open;
+};
+
+///
+/// The same as `view_tokenizer{view_input_reader{input}}.tape()`, but with the input split
+/// into (up to) `threads` chunks which are tokenized at once, each one on its own thread.
+///
+/// Whether a chunk starts inside a string is not known until the ones before it are looked
+/// at, so that is worked out first - each chunk counts its unescaped quotes and the counts
+/// before it tell. Then each chunk is moved to start at its first punctuator outside a
+/// string, which surely is where a token starts. The tapes of the chunks are put together
+/// at the end, pairing up the brackets which did not have a pair in their own chunk.
+///
+/// Small inputs are not worth the threads and are tokenized as usual. If the input is not
+/// valid, it is tokenized again from the start, so that the tape ends with the same error
+/// (and has the same tokens before it) as usual.
+///
+[[nodiscard]] token_tape parallel_tape(std::string_view input, std::size_t threads);
+
 ///
 /// Helper functions
 ///
@@ -252,6 +549,139 @@ const T *token_as(const mystd::unique_ptr<token> &abstract_token) {
     return dynamic_cast<const T *const>(abstract_token.get());
 }
 
+namespace detail {
+
+///
+/// The number scanner.
+/// Goes through the longest prefix of `input` which follows the JSON number grammar
+/// (`-? (0 | [1-9][0-9]*) (.[0-9]+)? ([eE][+-]?[0-9]+)?`) and converts it to the nearest
+/// double (or an exact integer, if it is one) while at it. `complete` is false if the prefix
+/// stops in the middle of the grammar (e.g. "1." or "-"). Nothing is allocated and the
+/// locale does not matter.
+///
+struct number_scan {
+    std::size_t length{0};
+    bool complete{false};
+    token_number number{0.0};
+};
+
+[[nodiscard]] number_scan scan_number(std::span<const char> input) noexcept;
+
+///
+/// The classes of symbols the tokenizer cares about, looked up in a table of all 256 of them
+/// instead of being compared against one by one (or asked about the locale). A symbol may be
+/// in a couple of classes at once, so each one is a bit.
+///
+namespace char_class {
+
+constexpr std::uint8_t whitespace = 1 << 0;
+constexpr std::uint8_t punct = 1 << 1;
+constexpr std::uint8_t quote = 1 << 2;
+constexpr std::uint8_t number_start = 1 << 3;
+constexpr std::uint8_t in_number = 1 << 4;
+constexpr std::uint8_t keyword_start = 1 << 5;
+constexpr std::uint8_t letter = 1 << 6;
+
+}
+
+inline constexpr auto char_classes = [] {
+    std::array<std::uint8_t, 256> table{};
+    auto add = [&](std::string_view symbols, std::uint8_t cls) {
+        for (char sym : symbols)
+            table[static_cast<unsigned char>(sym)] |= cls;
+    };
+    // The same as `std::isspace` in the "C" locale.
+    add(" \n\t\r\v\f", char_class::whitespace);
+    add("{}[]:,", char_class::punct);
+    add("\"", char_class::quote);
+    add("-0123456789", char_class::number_start);
+    add("0123456789.-+eE", char_class::in_number);
+    add("abcdefghijklmnopqrstuvwxyz", char_class::keyword_start | char_class::letter);
+    add("ABCDEFGHIJKLMNOPQRSTUVWXYZ", char_class::letter);
+    return table;
+}();
+
+[[nodiscard]] constexpr std::uint8_t classify(char sym) noexcept {
+    return char_classes[static_cast<unsigned char>(sym)];
+}
+
+[[nodiscard]] constexpr bool is(char sym, std::uint8_t cls) noexcept {
+    return (classify(sym) & cls) != 0;
+}
+
+/// Whether `sym` may be a part of a number - the ones after a number which must not be there.
+[[nodiscard]] constexpr bool valid_in_number(char sym) noexcept {
+    return is(sym, char_class::in_number);
+}
+
+/// How much of `input` is left once a UTF-8 sequence cut short at its end (if any) is dropped.
+/// Whether the sequences are valid is not checked.
+[[nodiscard]] constexpr std::size_t utf8_complete_prefix(std::span<const char> input) noexcept {
+    for (std::size_t back = 1; back <= 4 && back <= input.size(); ++back) {
+        const auto sym = static_cast<unsigned char>(input[input.size() - back]);
+        if ((sym & 0xc0) == 0x80)
+            continue; // A continuation - the lead is further back.
+        const std::size_t length = sym >= 0xf0 ? 4 : sym >= 0xe0 ? 3 : sym >= 0xc0 ? 2 : 1;
+        return length > back ? input.size() - back : input.size();
+    }
+    return input.size();
+}
+
+/// Where the first sequence of `input` which is not valid UTF-8 starts (`input.size()` if there
+/// is none) - with the same rules as `simd::validate_utf8()`. It goes a byte at a time, so it is
+/// for finding the error once it is known that there is one.
+[[nodiscard]] constexpr std::size_t first_invalid_utf8(std::span<const char> input) noexcept {
+    std::size_t i = 0;
+    while (i < input.size()) {
+        const auto lead = static_cast<unsigned char>(input[i]);
+        if (lead < 0x80) {
+            ++i;
+            continue;
+        }
+
+        // The second byte is what tells the overlong, surrogate and too big sequences apart.
+        std::size_t length = 0;
+        unsigned char second_min = 0x80, second_max = 0xbf;
+        if (lead >= 0xc2 && lead <= 0xdf) {
+            length = 2;
+        } else if (lead >= 0xe0 && lead <= 0xef) {
+            length = 3;
+            second_min = lead == 0xe0 ? 0xa0 : 0x80;
+            second_max = lead == 0xed ? 0x9f : 0xbf;
+        } else if (lead >= 0xf0 && lead <= 0xf4) {
+            length = 4;
+            second_min = lead == 0xf0 ? 0x90 : 0x80;
+            second_max = lead == 0xf4 ? 0x8f : 0xbf;
+        } else {
+            return i;
+        }
+        if (input.size() - i < length)
+            return i;
+        for (std::size_t j = 1; j < length; ++j) {
+            const auto sym = static_cast<unsigned char>(input[i + j]);
+            if (sym < (j == 1 ? second_min : 0x80) || sym > (j == 1 ? second_max : 0xbf))
+                return i;
+        }
+        i += length;
+    }
+    return i;
+}
+
+/// Appends the UTF-8 encoding of `code_point`, which is expected to be at most U+10FFFF.
+void append_utf8(std::string &out, char32_t code_point);
+
+}
+
+///
+/// The `token_sentinel` type.
+/// It marks the end of a token stream. As the end of the input is not necessarily
+/// known in advance (e.g. when reading from a pipe), an iterator is not compared
+/// to another "end" iterator but to this sentinel - it is equal to it once there
+/// are no more tokens left.
+///
+
+struct token_sentinel { };
+
 ///
 /// The `token_citerator` class
 /// This is the driver class for the tokenization process.
@@ -259,10 +689,15 @@ const T *token_as(const mystd::unique_ptr<token> &abstract_token) {
 /// an InputReader strategy which provides the implementation
 /// details for different inputs such as file (`ifs_input_reader`)
 /// and raw buffer bytes (`str_input_reader`).
+/// The iterator does not own the input reader - it refers to the one owned
+/// by the `tokenizer`, so all iterators over a token stream share a single
+/// underlying source. This makes the iterator a single-pass one: copies of it
+/// keep the token they currently hold, but only the most recently advanced
+/// one continues reading.
 ///
 
 template <typename InputReaderConcrete>
-    requires is_input_reader_v<InputReaderConcrete>
+    requires input_reader_strategy<InputReaderConcrete>
 class token_citerator final {
     using input_reader_type = InputReaderConcrete;
 
@@ -271,40 +706,51 @@ public:
     /// Special member functions
     ///
 
-    explicit token_citerator(const input_reader_type& ir)
-        try : m_input_reader { ir }
-            , m_current_location { ir.tell() }
+    explicit token_citerator(input_reader_type& ir)
+        try : m_input_reader { &ir }
+            , m_pos { ir.tell() }
     {
+        m_lines.begin = m_pos;
+
         // Safety: This is guaranteed by the input reader strategies ctors.
-        assert(m_input_reader.ready());
+        assert(m_input_reader->ready());
 
         // This means that the input is empty. The operator*() calls consume() if it
         // has not been called yet, meaning that dereferencing an empty input will
         // force-read a token - behaviour that we do not want.
-        if (m_input_reader.eof())
+        skip_to_token();
+        if (!has_more()) {
             m_consumed_first = true;
+            m_at_end = true;
+        }
     } catch (const input_reader_exception &ire) {
         throw token_exception{ire.what()};
     }
 
     token_citerator(const token_citerator& rhs)
-        try : m_input_reader { rhs.m_input_reader }
-        , m_current_location { rhs.m_current_location }
+        : m_input_reader { rhs.m_input_reader }
+        , m_pos { rhs.m_pos }
         , m_consumed_first { rhs.m_consumed_first }
-        , m_consumed { rhs.m_consumed ? rhs.m_consumed->clone() : nullptr }
+        , m_at_end { rhs.m_at_end }
+        , m_consumed { rhs.m_consumed }
+        , m_token_begin { rhs.m_token_begin }
+        , m_lines { rhs.m_lines }
+        , m_error { rhs.m_error }
     {
-        // Safety: This isguaranteed by the input reader strategies ctors.
-        assert(m_input_reader.ready());
-    } catch (const input_reader_exception &ire) {
-        throw token_exception{ire.what()};
+        // The structural index is left behind - the copy is not supposed to be advanced anyway.
     }
 
     token_citerator& operator=(const token_citerator& rhs)
     {
         m_input_reader = rhs.m_input_reader;
         m_consumed_first = rhs.m_consumed_first;
-        m_consumed = rhs.m_consumed ? rhs.m_consumed->clone() : nullptr ;
-        m_current_location = rhs.m_current_location;
+        m_at_end = rhs.m_at_end;
+        m_consumed = rhs.m_consumed;
+        m_token_begin = rhs.m_token_begin;
+        m_pos = rhs.m_pos;
+        m_index = {};
+        m_lines = rhs.m_lines;
+        m_error = rhs.m_error;
         return *this;
     }
 
@@ -314,53 +760,90 @@ public:
     ~token_citerator() noexcept = default;
 
     [[nodiscard]] bool operator==(const token_citerator &rhs) const noexcept {
-        return m_current_location == rhs.m_current_location;
+        return m_pos == rhs.m_pos;
     }
     [[nodiscard]] std::strong_ordering operator<=>(const token_citerator &rhs) const noexcept {
-        return m_current_location <=> rhs.m_current_location;
+        return m_pos <=> rhs.m_pos;
+    }
+
+    [[nodiscard]] bool operator==(token_sentinel) const noexcept {
+        return m_at_end;
     }
 
     ///
     /// Iterator behaviour
     ///
 
-    // Throws token_exception if the current token is consumed or if the entire token stream is empty.
-    [[nodiscard]] mystd::unique_ptr<token> operator*() {
-        if (!m_consumed && !m_consumed_first){
-            consume_and_store();
-            m_consumed_first = true;
-        }
+    // Throws token_exception if the token stream is over (or was empty in the first place).
+    // The token is held by the iterator - it may be moved out of, but it is overwritten once
+    // the iterator is advanced.
+    [[nodiscard]] token_value &operator*() {
+        if (!consume_first())
+            throw_error();
 
-        if (!m_consumed)
+        if (m_at_end)
             throw token_exception_here("Trying to access consumed token.");
+        return m_consumed;
+    }
 
-        auto consumed = std::move(m_consumed);
-        m_consumed.reset();
-        return consumed;
+    [[nodiscard]] token_value *operator->() {
+        return &**this;
     }
 
-    [[nodiscard]] const token *peek_unsafe() {
-        if (!m_consumed_first){
-            consume_and_store();
-            m_consumed_first = true;
-        }
+    /// Where the current token is in the input.
+    [[nodiscard]] std::size_t token_offset() {
+        if (!consume_first())
+            throw_error();
+        return m_token_begin;
+    }
 
-        return m_consumed.get();
+    [[nodiscard]] std::size_t token_length() {
+        if (!consume_first())
+            throw_error();
+        return m_pos - m_token_begin;
     }
 
     // Once the token stream is consumed no action is performed. However, if the "new" item is accessed
     // after the end, the an exception is thrown.
     token_citerator& operator++() {
-        consume_and_store();
+        if (!try_advance())
+            throw_error();
         return *this;
     }
 
+    // The returned copy holds the current token, but it must not be advanced as the input
+    // reader is shared and has already moved on.
     token_citerator operator++(int) {
+        if (!consume_first())
+            throw_error();
         auto copy {*this};
-        consume_and_store();
+        if (!consume_and_store())
+            throw_error();
         return copy;
     }
 
+    ///
+    /// The same without exceptions
+    /// Instead of throwing, these return that there is no token and leave what went wrong
+    /// in `error()`. After an error the iterator is at the end. Only the input reader may
+    /// still throw - if it fails to read the input at all, not if the input is over.
+    ///
+
+    /// The current token or null if there is none - either at the end or after an error.
+    [[nodiscard]] token_value *try_get() {
+        if (!consume_first() || m_at_end)
+            return nullptr;
+        return &m_consumed;
+    }
+
+    /// Same as `++it`, returns false if there is an error.
+    [[nodiscard]] bool try_advance() {
+        return consume_first() && consume_and_store();
+    }
+
+    [[nodiscard]] bool failed() const noexcept { return static_cast<bool>(m_error); }
+    [[nodiscard]] const parse_error &error() const noexcept { return m_error; }
+
 private:
 
     ///
@@ -370,142 +853,413 @@ private:
     /// `consume_and_store()` is the driver function - it calls `consume()` and stores its result
     /// in `m_consumed` which stores "the current token".
     ///
-    void consume_and_store() {
-        consume_whitespace();
-        if (has_more())
-            m_consumed = consume();
+    // Returns false if there is an error, which ends the token stream.
+    bool consume_and_store() {
+        skip_to_token();
+        m_at_end = !has_more();
+        if (m_at_end)
+            return true;
+
+        m_token_begin = m_pos;
+        if (consume())
+            return true;
+        m_at_end = true;
+        return false;
     }
 
-    mystd::unique_ptr<token> consume() {
-        consume_whitespace();
+    // Tokens are read lazily - the first one is read only once it is actually needed.
+    bool consume_first() {
+        if (!m_consumed_first) {
+            m_consumed_first = true;
+            return consume_and_store();
+        }
+        return !failed();
+    }
 
-        switch ([[maybe_unused]] char sym = peek()) {
-        case '-': [[fallthrough]];
-        case '0' ... '9':
+    // The `consume_*` functions return false if there is an error (see `fail()`).
+    bool consume() {
+        const std::uint8_t cls = detail::classify(peek());
+        if (cls & detail::char_class::number_start)
             return consume_number();
-        case '"':
+        if (cls & detail::char_class::quote)
             return consume_string();
-        case 'a' ... 'z':
+        if (cls & detail::char_class::keyword_start)
             return consume_keyword();
-        default:
-            return consume_punct();
+        return consume_punct();
+    }
+
+    bool consume_number() {
+        const std::size_t start = m_pos;
+        std::span<const char> chunk = window();
+        detail::number_scan scan = detail::scan_number(chunk);
+
+        // A number which reaches the end of the window may go on after it. That is rare (most
+        // windows hold much more than a number), so such one is gathered on the side first.
+        std::string spilled;
+        if (scan.length == chunk.size()) {
+            spilled = scan_while(detail::valid_in_number);
+            chunk = spilled;
+            scan = detail::scan_number(chunk);
+            // A number which is not finished when the gathered symbols run out is cut by
+            // whatever comes after them, just as it is when the whole number is in the window.
+            const std::span<const char> after = window();
+            if (!scan.complete && scan.length == chunk.size() && !after.empty())
+                return unexpected_symbol(after.front(), location_at(start + scan.length));
+        } else {
+            advance(scan.length);
         }
 
-        mystd::unreachable();
+        // The gathered number may go on past the bad symbol, so the symbol is found from
+        // where the number starts rather than from where the input is at.
+        if (scan.length < chunk.size() && (!scan.complete || detail::valid_in_number(chunk[scan.length])))
+            return unexpected_symbol(chunk[scan.length], location_at(start + scan.length));
+        if (!scan.complete)
+            return fail_end();
+        m_consumed.set_number(scan.number);
+        return true;
     }
 
-    mystd::unique_ptr<token> consume_number() {
-        std::string value;
-        auto valid_in_number = [](char sym) -> bool {
-            return std::isdigit(sym)
-                   || sym == '.'
-                   || sym == '-'
-                   || sym == '+'
-                   || sym == 'e' || sym == 'E';
-        };
+    bool consume_string() {
+        if (!expect_symbol('"')) // Strings always begin this way.
+            return false;
+
+        // The whole input is in memory and stays there, so a string without escape sequences
+        // may just refer to it.
+        if constexpr (stable_input_reader<input_reader_type>) {
+            const std::span<const char> chunk = window();
+            const std::size_t count = simd::scan_string(chunk);
+            if (count < chunk.size() && chunk[count] == '"') {
+                if (!expect_valid_utf8(chunk.first(count)))
+                    return false;
+                m_consumed.set_borrowed_string({chunk.data(), count});
+                advance(count);
+                return expect_symbol('"');
+            }
+        }
 
-        for (char sym = peek(); valid_in_number(sym); sym = peek()){
-            value += get();
-            if (!has_more())
+        std::string &value = m_consumed.set_string();
+        for (;;) {
+            const std::span<const char> chunk = window();
+            if (chunk.empty())
+                return fail_end();
+
+            // Everything up to the closing quote or the next escape sequence is taken at once.
+            // If that is the end of the window, it may be in the middle of a multi-byte symbol,
+            // which is left for the next window.
+            const std::size_t count = simd::scan_string(chunk);
+            std::span<const char> run = chunk.first(count);
+            if (count == chunk.size()) {
+                const std::size_t complete = detail::utf8_complete_prefix(run);
+                if (complete == 0) {
+                    if (!consume_split_symbol(value))
+                        return false;
+                    continue;
+                }
+                run = run.first(complete);
+            }
+            if (!expect_valid_utf8(run))
+                return false;
+            value.append(run.data(), run.size());
+            advance(run.size());
+            if (run.size() == chunk.size() || run.size() < count)
+                continue;
+            if (chunk[count] == '"')
                 break;
+
+            // Escape sequences are rare, so they are handled a symbol at a time.
+            advance(1);
+            char sym{};
+            if (!get(sym))
+                return false;
+            char32_t code_point{};
+            switch (sym) {
+                // clang-format off
+                break; case '"': value += '"';
+                break; case '\\': value += '\\';
+                break; case '/': value += '/';
+                break; case 'b': value += '\b';
+                break; case 'f': value += '\f';
+                break; case 'n': value += '\n';
+                break; case 'r': value += '\r';
+                break; case 't': value += '\t';
+                break; case 'u': if (!consume_escaped_code_point(code_point)) return false;
+                                 detail::append_utf8(value, code_point);
+                break; default: return unexpected_symbol(sym);
+                // clang-format on
+            }
         }
+        return expect_symbol('"');
+    }
 
-        return make_token<token_number>(std::atof(value.c_str()));
+    // The window holds just a part of a multi-byte symbol, so it is gathered a byte at a time.
+    // If it is not valid, it is reported where it starts - as it is when it is in one window.
+    bool consume_split_symbol(std::string &value) {
+        const std::size_t start = m_pos;
+        char symbol[4]{};
+        if (!get(symbol[0]))
+            return false;
+        const auto lead = static_cast<unsigned char>(symbol[0]);
+        const std::size_t length = lead >= 0xf0 ? 4 : lead >= 0xe0 ? 3 : 2;
+        for (std::size_t i = 1; i < length; ++i) {
+            if (!get(symbol[i]))
+                return false;
+            if ((static_cast<unsigned char>(symbol[i]) & 0xc0) != 0x80)
+                return invalid_utf8(start);
+        }
+        if (!simd::validate_utf8({symbol, length}))
+            return invalid_utf8(start);
+        value.append(symbol, length);
+        return true;
     }
 
-    mystd::unique_ptr<token> consume_string() {
-        std::string value;
-        expect_symbol('"'); // Strings always begin this way.
-        while (peek() != '"'){
-            value += get();
-            if (value.back() == '\\') {
-                switch (char sym = get()) {
-                    // clang-format off
-                    break; case 'n': value.back() = '\n';
-                    break; case 'r': value.back() = '\r';
-                    break; case 't': value.back() = '\t';
-                    break; default: value += sym;
-                    // clang-format on
-                }
+    // The part of a "\uXXXX" escape after the "\u". Surrogate pairs come as two such escapes.
+    bool consume_escaped_code_point(char32_t &code_point) {
+        auto hex_quad = [this](char32_t &code_unit) {
+            code_unit = 0;
+            for (int i = 0; i < 4; ++i) {
+                char sym{};
+                if (!get(sym))
+                    return false;
+                code_unit <<= 4;
+                if (sym >= '0' && sym <= '9')
+                    code_unit |= static_cast<char32_t>(sym - '0');
+                else if (sym >= 'a' && sym <= 'f')
+                    code_unit |= static_cast<char32_t>(sym - 'a' + 10);
+                else if (sym >= 'A' && sym <= 'F')
+                    code_unit |= static_cast<char32_t>(sym - 'A' + 10);
+                else
+                    return unexpected_symbol(sym);
             }
+            return true;
+        };
+        auto invalid_escape = [this]() {
+            return fail(parse_errc::unpaired_surrogate,
+                        current_location().to_string() + ": Unpaired surrogate in a \"\\u\" escape sequence.");
+        };
+
+        char32_t high{};
+        if (!hex_quad(high))
+            return false;
+        if (high >= 0xdc00 && high <= 0xdfff)
+            return invalid_escape();
+        if (!(high >= 0xd800 && high <= 0xdbff)) {
+            code_point = high;
+            return true;
         }
-        expect_symbol('"');
 
-        return make_token<token_string>(value);
+        char backslash{}, u{};
+        if (!get(backslash) || !get(u))
+            return false;
+        if (backslash != '\\' || u != 'u')
+            return invalid_escape();
+        char32_t low{};
+        if (!hex_quad(low))
+            return false;
+        if (!(low >= 0xdc00 && low <= 0xdfff))
+            return invalid_escape();
+        code_point = 0x10000 + ((high - 0xd800) << 10) + (low - 0xdc00);
+        return true;
     }
 
-    mystd::unique_ptr<token> consume_keyword() {
-        const static std::string literal_true = "true";
-        const static std::string literal_false = "false";
-        const static std::string literal_null = "null";
+    bool consume_keyword() {
+        using namespace std::string_view_literals;
+        auto is_letter = [](char sym) { return detail::is(sym, detail::char_class::letter); };
+
+        // Keywords are short, so they are almost always whole in the window (with the symbol
+        // after them) and the first letter tells which one it has to be.
+        const std::span<const char> chunk = window();
+        auto matches = [&](std::string_view keyword) {
+            return keyword.size() < chunk.size()
+                   && std::memcmp(chunk.data(), keyword.data(), keyword.size()) == 0
+                   && !is_letter(chunk[keyword.size()]);
+        };
+        using enum token_keyword::kind;
+        switch (chunk.empty() ? '\0' : chunk[0]) {
+            // clang-format off
+            break; case 't': if (matches("true"sv)) { advance(4); m_consumed.set_keyword(True); return true; }
+            break; case 'f': if (matches("false"sv)) { advance(5); m_consumed.set_keyword(False); return true; }
+            break; case 'n': if (matches("null"sv)) { advance(4); m_consumed.set_keyword(Null); return true; }
+            // clang-format on
+        }
 
-        std::string value;
-        while (std::isalpha(peek()))
-            value += get();
+        // Otherwise (or if they are not keywords after all) they are gathered on the side.
+        std::size_t length = 0;
+        while (length < chunk.size() && is_letter(chunk[length]))
+            ++length;
+        std::string spilled;
+        std::string_view value{chunk.data(), length};
+        if (length == chunk.size()) {
+            spilled = scan_while(is_letter);
+            value = spilled;
+        } else {
+            advance(length);
+        }
 
-        using enum token_keyword::kind;
-        if (value == literal_true)
-            return make_token<token_keyword>(True);
-        if (value == literal_false)
-            return make_token<token_keyword>(False);
-        if (value == literal_null)
-            return make_token<token_keyword>(Null);
+        if (value == "true"sv)
+            m_consumed.set_keyword(True);
+        else if (value == "false"sv)
+            m_consumed.set_keyword(False);
+        else if (value == "null"sv)
+            m_consumed.set_keyword(Null);
+        else
+            return unexpected_symbol(value.back());
+        return true;
+    }
 
-        unexpected_symbol(value.back());
+    bool consume_punct(){
+        char sym{};
+        if (!get(sym))
+            return false;
+        if (!detail::is(sym, detail::char_class::punct))
+            return unexpected_symbol(sym);
+        m_consumed.set_punct(sym);
+        return true;
     }
 
-    mystd::unique_ptr<token> consume_punct(){
-        const char sym = get();
-        if (token_punct::is_valid(sym))
-            return make_token<token_punct>(sym);
-        unexpected_symbol(sym);
+    // Consumes at most `max` whitespace symbols. Returns false if it stops earlier - either at
+    // a symbol which is not whitespace or at the end of the input.
+    bool consume_whitespace(std::size_t max = std::numeric_limits<std::size_t>::max()) {
+        while (max > 0) {
+            const std::span<const char> chunk = window();
+            if (chunk.empty())
+                return false;
+
+            // Tokens are often right next to each other, so check for that before calling the kernel.
+            if (!detail::is(chunk[0], detail::char_class::whitespace))
+                return false;
+
+            const std::size_t limit = std::min(max, chunk.size());
+            const std::size_t run = simd::scan_whitespace(chunk, limit);
+            advance(run);
+            max -= run;
+            if (run < limit)
+                return false;
+        }
+        return true;
     }
 
-    void consume_whitespace() {
-        while (has_more() && std::isspace(peek())) {
-            char sym = get(get_preference::DontUpdateLocation);
-            // clang-format off
-            switch (sym) {
-                break; case '\n':
-                m_current_location.column_num() = 0;
-                ++m_current_location.line_num();
-                break; case '\t':
-                m_current_location.column_num() += 4;
-                ++m_current_location.line_num();
-                break; case '\r':
-                m_current_location.column_num() = 0;
-                break; case ' ': [[fallthrough]];
-            default:   // eof
-                ++m_current_location.column_num();
+    ///
+    /// The structural index
+    /// Instead of looking at every symbol between the tokens, the tokenizer asks the SIMD
+    /// kernels where the next tokens start (see `simd::index_structurals`) for a whole chunk
+    /// of the input at once and then jumps from one to the next. The index is built from
+    /// where the tokenizer currently is, which is always between two tokens, and is rebuilt
+    /// once the tokenizer gets past its end.
+    ///
+
+    // Moves to where the next token starts. Only the whitespace before it is looked at (in
+    // order to make sure there is nothing else).
+    void skip_to_token() {
+        for (;;) {
+            const std::size_t pos = m_pos;
+            if (!(m_index.begin <= pos && pos < m_index.end) && !build_index())
+                return;
+
+            // Skip the tokens which are already consumed.
+            const auto &positions = m_index.positions;
+            while (m_index.next < positions.size() && m_index.begin + positions[m_index.next] < pos)
+                ++m_index.next;
+
+            const std::size_t target = m_index.next < positions.size()
+                                       ? m_index.begin + positions[m_index.next]
+                                       : m_index.end;
+            if (!consume_whitespace(target - pos)) {
+                // Something which the index did not expect to be there (e.g. a number with a
+                // letter stuck to it) - the index is no good anymore and the symbol is left
+                // to `consume()` to deal with.
+                m_index.end = m_index.begin;
+                return;
             }
-            // clang-format on
+            if (target < m_index.end)
+                return;
         }
     }
 
+    bool build_index() {
+        const std::span<const char> chunk = window(index_window_size);
+        if (chunk.empty())
+            return false;
+
+        const std::size_t size = std::min(chunk.size(), index_window_size);
+        // There may be as many tokens as symbols - allocating for that once is enough.
+        m_index.positions.reserve(index_window_size);
+        m_index.begin = m_pos;
+        m_index.end = m_index.begin + size;
+        m_index.positions.clear();
+        m_index.next = 0;
+
+        // The line index moves on together with the structural one. The copies of the iterator
+        // may still need the line breaks behind, so those are left to them.
+        const location here = current_location();
+        m_lines.begin = m_pos;
+        m_lines.line = here.line_num();
+        m_lines.column = here.column_num();
+        if (!m_lines.breaks || m_lines.breaks.use_count() > 1)
+            m_lines.breaks = std::make_shared<std::vector<std::uint32_t>>();
+        m_lines.breaks->clear();
+
+        simd::index_structurals(chunk.first(size), m_index.positions, *m_lines.breaks);
+        return true;
+    }
+
+    // Consumes the longest run of symbols which satisfy `pred`, a window at a time.
+    template <typename Pred>
+    std::string scan_while(Pred pred) {
+        std::string run;
+        for (std::span<const char> chunk = window(); !chunk.empty(); chunk = window()) {
+            std::size_t count = 0;
+            while (count < chunk.size() && pred(chunk[count]))
+                ++count;
+            run.append(chunk.data(), count);
+            advance(count);
+            if (count < chunk.size())
+                break;
+        }
+        return run;
+    }
+
     char peek() const {
         try {
-            return m_input_reader.peek();
+            return m_input_reader->peek();
         } catch (const input_reader_exception &ire) {
             throw token_exception_here(ire.what());
         }
     }
 
-    enum class get_preference {
-        DontUpdateLocation,
-        UpdateLocation
-    };
+    // The end of the input is an error, but it is not up to the input reader to report it.
+    bool get(char &sym) {
+        if (!has_more())
+            return fail_end();
+        try {
+            sym = m_input_reader->get();
+        } catch (input_reader_exception &ire) {
+            throw token_exception_here(ire.what());
+        }
+        ++m_pos;
+        return true;
+    }
+
+    // How much input is asked for at once when scanning runs of symbols.
+    static constexpr std::size_t window_size = 256;
+
+    // How much input is indexed at once.
+    static constexpr std::size_t index_window_size = 16 * 1024;
+
+    std::span<const char> window(std::size_t n = window_size) const {
+        try {
+            return m_input_reader->window(n);
+        } catch (const input_reader_exception &ire) {
+            throw token_exception_here(ire.what());
+        }
+    }
 
-    char get(get_preference preference = get_preference::UpdateLocation) {
-        char sym;
+    void advance(std::size_t count) {
         try {
-            sym = m_input_reader.get();
-            m_current_location.detail_pos() = m_input_reader.tell();
+            m_input_reader->advance(count);
         } catch (input_reader_exception &ire) {
             throw token_exception_here(ire.what());
         }
-        if (preference == get_preference::UpdateLocation)
-            ++m_current_location.column_num();
-        return sym;
+        m_pos += count;
     }
 
     ///
@@ -513,31 +1267,67 @@ private:
     /// Most of them are private as they are only helpful during the tokenization process,
     /// but there are some which are using by the parser.
 private:
-    void expect_symbol(char sym) {
-        if (const char next_sym = get(); next_sym != sym) {
-            std::string msg = m_current_location.to_string() + ": Expected '" + sym + "' but got '" + next_sym + "' instead.";
-            throw token_exception_here(std::move(msg));
-        }
+    bool expect_symbol(char sym) {
+        char next_sym{};
+        if (!get(next_sym))
+            return false;
+        if (next_sym != sym)
+            return fail(parse_errc::unexpected_symbol,
+                        current_location().to_string() + ": Expected '" + sym + "' but got '" + next_sym + "' instead.");
+        return true;
     }
 
-    [[noreturn]] void unexpected_symbol(char sym) {
-        std::string msg = m_current_location.to_string() + ": Unexpected symbol '" + sym + "' found.";
-        throw token_exception_here(std::move(msg));
+    // The run is where the input is at. If it is not valid, it is looked through again for
+    // where exactly, so that the error does not depend on how the input is split into windows.
+    bool expect_valid_utf8(std::span<const char> run) {
+        if (!simd::validate_utf8(run))
+            return invalid_utf8(m_pos + detail::first_invalid_utf8(run));
+        return true;
+    }
+
+    bool invalid_utf8(std::size_t at) {
+        const location where = location_at(at);
+        return fail(parse_errc::invalid_utf8, where.to_string() + ": Invalid UTF-8 in a string.", where);
+    }
+
+    bool unexpected_symbol(char sym) { return unexpected_symbol(sym, current_location()); }
+
+    bool unexpected_symbol(char sym, const location &where) {
+        return fail(parse_errc::unexpected_symbol, where.to_string() + ": Unexpected symbol '" + sym + "' found.", where);
+    }
+
+    bool fail_end() {
+        return fail(parse_errc::unexpected_end, current_location().to_string() + ": Trying to consume after end.");
+    }
+
+    // Keeps what went wrong for `error()`. Always returns false, so that it can be returned.
+    bool fail(parse_errc code, std::string msg) { return fail(code, std::move(msg), current_location()); }
+
+    bool fail(parse_errc code, std::string msg, const location &where) {
+        m_error = parse_error{code, where, std::move(msg)};
+        return false;
+    }
+
+    [[noreturn]] void throw_error() const {
+        throw token_exception{m_error.message, m_error.where};
     }
 
     template <typename T>
     [[nodiscard]] token_exception token_exception_here(T&& msg) const {
-        return token_exception{std::forward<T>(msg), m_current_location};
+        return token_exception{std::forward<T>(msg), current_location()};
     }
 
 public:
-    [[nodiscard]] bool has_more() const noexcept { return !m_input_reader.eof(); }
+    [[nodiscard]] bool has_more() const noexcept { return !m_input_reader->eof(); }
 
     void expect_has_more() const {
-        if (!has_more()) {
-            std::string msg = m_current_location.to_string() + ": Trying to consume after end.";
-            throw token_exception_here(std::move(msg));
-        }
+        if (!has_more())
+            unexpected_end();
+    }
+
+    [[noreturn]] void unexpected_end() const {
+        std::string msg = current_location().to_string() + ": Trying to consume after end.";
+        throw token_exception_here(std::move(msg));
     }
 
 public:
@@ -546,24 +1336,81 @@ public:
     ///
 
     [[nodiscard]] const input_reader_type &input_reader() const & {
-        return m_input_reader;
+        return *m_input_reader;
     }
 
-    [[nodiscard]] const location &current_location() const & {
-        return m_current_location;
-    }
+    /// The line and column are not kept track of while going through the input, as they are
+    /// needed only for reporting errors. Instead, they are worked out from the line breaks
+    /// found by the structural index: '\n' starts a new line, '\r' goes back to its start,
+    /// '\t' takes 4 columns (and a line, for historical reasons) and every other symbol
+    /// (including the ones in strings) takes a single column.
+    [[nodiscard]] location current_location() const { return location_at(m_pos); }
+
+private:
+    // Where `pos` is - as long as it is not before the last line checkpoint.
+    [[nodiscard]] location location_at(std::size_t pos) const {
+        location here{pos};
+        std::size_t line = m_lines.line;
+        std::size_t column = m_lines.column;
+
+        const std::size_t offset = pos - m_lines.begin;
+        std::size_t plain_start = 0;
+        if (m_lines.breaks) {
+            for (const std::uint32_t entry : *m_lines.breaks) {
+                const std::size_t at = entry & simd::line_break_position_mask;
+                if (!(at < offset))
+                    break;
+                column += at - plain_start;
+                switch (static_cast<simd::line_break>(entry >> simd::line_break_shift)) {
+                    // clang-format off
+                    break; case simd::line_break::newline: ++line; column = 0;
+                    break; case simd::line_break::carriage_return: column = 0;
+                    break; case simd::line_break::tab: ++line; column += 4;
+                    // clang-format on
+                }
+                plain_start = at + 1;
+            }
+        }
+        column += offset - plain_start;
 
-    [[nodiscard]] location current_location() && {
-        return std::move(m_current_location);
+        here.line_num() = line;
+        here.column_num() = column;
+        return here;
     }
 
 private:
-    input_reader_type m_input_reader;
+    // Owned by the `tokenizer`.
+    input_reader_type *m_input_reader;
 
-    location m_current_location;
+    // Only the offset is kept track of (see `current_location()`).
+    std::size_t m_pos;
 
     bool m_consumed_first{false};
-    mystd::unique_ptr<token> m_consumed;
+    bool m_at_end{false};
+    token_value m_consumed;
+    std::size_t m_token_begin{0};
+
+    struct structural_index {
+        std::size_t begin{0};
+        std::size_t end{0};
+        // Relative to `begin`.
+        std::vector<std::uint32_t> positions;
+        // The first of the `positions` which may still be ahead.
+        std::size_t next{0};
+    } m_index;
+
+    // The line and column at `begin` (which is where the structural index starts) and where
+    // the line breaks after it are (see `simd::index_structurals`). Shared with the copies of
+    // the iterator, which do not move on with it.
+    struct line_index {
+        std::size_t begin{0};
+        std::size_t line{0};
+        std::size_t column{0};
+        std::shared_ptr<std::vector<std::uint32_t>> breaks;
+    } m_lines;
+
+    // Set once the tokenization fails, after which there are no more tokens.
+    parse_error m_error;
 };
 
 ///
@@ -572,11 +1419,13 @@ private:
 /// I primarily wanted it for testing purposes in order to have a
 /// type which is reponsible for creating begin and end token iterators.
 /// The `tokenizer` type is generic over the input reader strategy and
-/// passess is directly to the `token_citerator`s that it creates.
+/// owns the only instance of it - the `token_citerator`s that it creates
+/// refer to it, so they must not outlive the tokenizer. The end of the
+/// token stream is marked by a `token_sentinel`.
 ///
 
 template <typename InputReaderConcrete>
-    requires is_input_reader_v<InputReaderConcrete>
+    requires input_reader_strategy<InputReaderConcrete>
 class tokenizer {
     using input_reader_type = InputReaderConcrete;
 
@@ -590,12 +1439,37 @@ public:
 public:
     using token_iterator_type = token_citerator<input_reader_type>;
 
-    token_iterator_type begin() const {
-        return token_iterator_type { m_input_reader.begin() };
+    // The token stream is single-pass, so the iterator starts wherever the
+    // input reader currently is.
+    token_iterator_type begin() {
+        return token_iterator_type { m_input_reader };
+    }
+
+    token_sentinel end() const noexcept {
+        return {};
     }
 
-    token_iterator_type end() const {
-        return token_iterator_type { m_input_reader.end() };
+    /// Goes through the rest of the tokens at once and puts them on a tape. If they are not
+    /// valid, the tape ends where they stop being valid (see `token_tape::failed()`). Only the
+    /// input reader failing to read the input is thrown.
+    [[nodiscard]] token_tape tape() {
+        token_iterator_type it = begin();
+        return tape(it);
+    }
+
+    /// The same, but going on from `it` - which keeps track of the lines it has gone
+    /// through, so the errors are reported at the same place as they would be by `it` itself.
+    [[nodiscard]] token_tape tape(token_iterator_type &it) {
+        token_tape tape;
+        for (const token_value *token = it.try_get(); token; token = it.try_get()) {
+            tape.append(*token, it.token_offset(), it.token_length());
+            if (!it.try_advance())
+                break;
+        }
+        if (it.failed())
+            tape.set_error(it.error());
+        tape.set_input_end(it.current_location().detail_pos());
+        return tape;
     }
 
 public:
@@ -611,6 +1485,13 @@ private:
 /// Aliases
 using ifs_tokenizer = tokenizer<ifs_input_reader>;
 using str_tokenizer = tokenizer<str_input_reader>;
+using view_tokenizer = tokenizer<view_input_reader>;
+using rope_tokenizer = tokenizer<rope_input_reader>;
+using mmap_tokenizer = tokenizer<mmap_input_reader>;
+using buf_tokenizer = tokenizer<buf_input_reader>;
+using stream_tokenizer = tokenizer<stream_input_reader>;
+using compressed_tokenizer = tokenizer<compressed_input_reader>;
+using async_tokenizer = tokenizer<async_input_reader>;
 
 } // namespace json_parser
 
@@ -0,0 +1,563 @@
+#include <cerrno>
+#include <cstring>
+#include <atomic>
+#include <thread>
+#include <semaphore>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <zlib.h>
+#ifdef FMI_JSON_PARSER_HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+#include <json-parser/input_reader.h>
+
+namespace json_parser {
+
+///
+/// mmap_input_reader
+///
+
+mmap_input_reader::mmap_input_reader(const std::string &filename) {
+    const std::string cannot_open_msg = "Cannot open input '" + filename + "' of type `mmap_input_reader`.";
+
+    const int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0)
+        throw input_reader_exception{cannot_open_msg};
+
+    struct stat st;
+    if (::fstat(fd, &st) < 0 || !S_ISREG(st.st_mode)) {
+        ::close(fd);
+        throw input_reader_exception{cannot_open_msg};
+    }
+
+    auto mapped = std::make_shared<mapping>();
+    mapped->filename = filename;
+    mapped->size = static_cast<std::size_t>(st.st_size);
+
+    if (mapped->size > 0) {
+        void *data = ::mmap(nullptr, mapped->size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data == MAP_FAILED) {
+            ::close(fd);
+            throw input_reader_exception{"Cannot map input '" + filename + "' of type `mmap_input_reader`."};
+        }
+        // The input is consumed front to back, so let the kernel read ahead aggressively.
+        ::madvise(data, mapped->size, MADV_SEQUENTIAL);
+        mapped->data = static_cast<const char *>(data);
+    }
+
+    // The mapping stays valid after the descriptor is closed.
+    ::close(fd);
+    m_mapping = std::move(mapped);
+}
+
+mmap_input_reader::mapping::~mapping() noexcept {
+    if (data)
+        ::munmap(const_cast<char *>(data), size);
+}
+
+///
+/// buf_input_reader
+///
+
+buf_input_reader::buf_input_reader(const std::string &filename, std::size_t block_size)
+    : m_window{block_size} {
+    attach(::open(filename.c_str(), O_RDONLY), filename, /* owns_fd */ true);
+}
+
+buf_input_reader::buf_input_reader(int fd, std::size_t block_size)
+    : m_window{block_size} {
+    attach(fd, "fd " + std::to_string(fd), /* owns_fd */ false);
+}
+
+void buf_input_reader::attach(int fd, std::string name, bool owns_fd) {
+    // The source is created first so that an owned descriptor gets closed even if the checks below throw.
+    m_source = std::make_shared<source>();
+    m_source->name = std::move(name);
+    m_source->fd = fd;
+    m_source->owns_fd = owns_fd;
+
+    struct stat st;
+    if (fd < 0 || ::fstat(fd, &st) < 0)
+        throw input_reader_exception{"Cannot open input '" + m_source->name + "' of type `buf_input_reader`."};
+
+    if (block_size() == 0)
+        throw input_reader_exception{"Cannot use input '" + m_source->name + "' of type `buf_input_reader` with an empty block size."};
+
+    // Only regular files have a known size and support reading at arbitrary offsets.
+    // Everything else (pipes, FIFOs, terminals, sockets) is treated as a forward-only stream.
+    m_source->seekable = S_ISREG(st.st_mode);
+    if (m_source->seekable)
+        m_source->size = static_cast<pos_type>(st.st_size);
+}
+
+buf_input_reader::source::~source() noexcept {
+    if (owns_fd && fd >= 0)
+        ::close(fd);
+}
+
+bool buf_input_reader::fill(std::size_t n) const {
+    source &src = *m_source;
+
+    auto checked = [&](ssize_t count) -> std::size_t {
+        if (count < 0)
+            throw input_reader_exception{"Cannot read from input '" + src.name + "' of type `buf_input_reader`."};
+        return static_cast<std::size_t>(count);
+    };
+
+    if (src.seekable) {
+        if (!(m_pos < src.size))
+            return false;
+        // Regular files are read right at the position, so the window simply starts over there.
+        m_window.reset(m_pos);
+        return m_window.slide(m_pos, n, [&](char *dest, std::size_t max) {
+            ssize_t count;
+            do {
+                count = ::pread(src.fd, dest, max, static_cast<off_t>(m_window.end_pos()));
+            } while (count < 0 && errno == EINTR);
+            return checked(count);
+        });
+    }
+
+    // Streams can only move forward. Whatever is before the window is gone for good and so
+    // is whatever another copy of the reader has already consumed.
+    const std::string cannot_seek_msg = "Cannot seek backwards in non-seekable input '" + src.name + "' of type `buf_input_reader`.";
+    if (!m_window.contains(m_pos) && m_window.end_pos() != src.stream_pos) {
+        if (m_pos < src.stream_pos)
+            throw input_reader_exception{cannot_seek_msg};
+        m_window.reset(src.stream_pos);
+    }
+    if (m_pos < m_window.begin_pos())
+        throw input_reader_exception{cannot_seek_msg};
+
+    return m_window.slide(m_pos, n, [&](char *dest, std::size_t max) {
+        ssize_t count;
+        do {
+            count = ::read(src.fd, dest, max);
+        } while (count < 0 && errno == EINTR);
+        const std::size_t read = checked(count);
+        src.stream_pos += read;
+        return read;
+    });
+}
+
+///
+/// Prefetching shared by `compressed_input_reader` and `async_input_reader`
+///
+
+namespace detail {
+
+struct open_file {
+    ~open_file() noexcept {
+        if (fd >= 0)
+            ::close(fd);
+    }
+
+    [[nodiscard]] std::string error(const std::string &what) const {
+        return "Cannot " + what + " input '" + name + "' of type `" + kind + "`.";
+    }
+
+    std::string name;
+    std::string kind;
+    int fd{-1};
+};
+
+namespace {
+
+std::shared_ptr<const open_file> open_regular_file(const std::string &filename, const std::string &kind, std::size_t *size = nullptr) {
+    auto file = std::make_shared<open_file>();
+    file->name = filename;
+    file->kind = kind;
+    file->fd = ::open(filename.c_str(), O_RDONLY);
+
+    struct stat st;
+    if (file->fd < 0 || ::fstat(file->fd, &st) < 0 || !S_ISREG(st.st_mode))
+        throw input_reader_exception{file->error("open")};
+    if (size)
+        *size = static_cast<std::size_t>(st.st_size);
+    return file;
+}
+
+// Produces the contents of a file piece by piece.
+class block_source {
+public:
+    virtual ~block_source() noexcept = default;
+
+    // Writes at most `max` symbols into `dest` and returns how many.
+    // Returns 0 only once the whole input is over.
+    virtual std::size_t produce(char *dest, std::size_t max) = 0;
+};
+
+// Reads the raw bytes of a file starting at some offset.
+class file_source final : public block_source {
+public:
+    file_source(std::shared_ptr<const open_file> file, std::size_t offset)
+        : m_file{std::move(file)}
+        , m_offset{offset} {
+        // The file is read front to back, so let the kernel read ahead more aggressively.
+        ::posix_fadvise(m_file->fd, static_cast<off_t>(m_offset), 0, POSIX_FADV_SEQUENTIAL);
+    }
+
+    // Reads as much as possible, i.e. until `max` symbols are read or the file ends.
+    std::size_t produce(char *dest, std::size_t max) override {
+        // Ask for the next piece upfront, so that it is on its way while this one is used.
+        ::posix_fadvise(m_file->fd, static_cast<off_t>(m_offset + max), static_cast<off_t>(max), POSIX_FADV_WILLNEED);
+
+        std::size_t total = 0;
+        while (total < max) {
+            const ssize_t count = ::pread(m_file->fd, dest + total, max - total, static_cast<off_t>(m_offset + total));
+            if (count < 0 && errno == EINTR)
+                continue;
+            if (count < 0)
+                throw input_reader_exception{m_file->error("read from")};
+            if (count == 0)
+                break;
+            total += static_cast<std::size_t>(count);
+        }
+        m_offset += total;
+        return total;
+    }
+
+    [[nodiscard]] const open_file &file() const noexcept { return *m_file; }
+
+private:
+    std::shared_ptr<const open_file> m_file;
+    std::size_t m_offset;
+};
+
+class gzip_source final : public block_source {
+public:
+    explicit gzip_source(std::shared_ptr<const open_file> file)
+        : m_compressed{std::move(file), 0}
+        , m_in{std::make_unique<char[]>(in_size)} {
+        // 32 makes zlib detect whether there is a gzip or a zlib header.
+        if (::inflateInit2(&m_strm, 15 + 32) != Z_OK)
+            throw input_reader_exception{m_compressed.file().error("decompress")};
+    }
+
+    ~gzip_source() noexcept override { ::inflateEnd(&m_strm); }
+
+    std::size_t produce(char *dest, std::size_t max) override {
+        m_strm.next_out = reinterpret_cast<Bytef *>(dest);
+        m_strm.avail_out = static_cast<uInt>(max);
+
+        while (m_strm.avail_out > 0) {
+            if (m_strm.avail_in == 0) {
+                const std::size_t count = m_compressed.produce(m_in.get(), in_size);
+                if (count == 0) {
+                    if (!m_member_ended)
+                        throw input_reader_exception{m_compressed.file().error("decompress the truncated")};
+                    break;
+                }
+                m_strm.next_in = reinterpret_cast<Bytef *>(m_in.get());
+                m_strm.avail_in = static_cast<uInt>(count);
+            }
+
+            const int rc = ::inflate(&m_strm, Z_NO_FLUSH);
+            if (rc == Z_STREAM_END) {
+                // gzip files may consist of several members one after another.
+                m_member_ended = true;
+                ::inflateReset(&m_strm);
+            } else if (rc == Z_OK) {
+                m_member_ended = false;
+            } else {
+                throw input_reader_exception{m_compressed.file().error("decompress the corrupted")};
+            }
+        }
+
+        return max - m_strm.avail_out;
+    }
+
+private:
+    static constexpr std::size_t in_size = 64 * 1024;
+
+    file_source m_compressed;
+    std::unique_ptr<char[]> m_in;
+    z_stream m_strm{};
+    bool m_member_ended{false};
+};
+
+#ifdef FMI_JSON_PARSER_HAVE_ZSTD
+class zstd_source final : public block_source {
+public:
+    explicit zstd_source(std::shared_ptr<const open_file> file)
+        : m_compressed{std::move(file), 0}
+        , m_in{std::make_unique<char[]>(ZSTD_DStreamInSize())}
+        , m_dstream{::ZSTD_createDStream()} {
+        if (!m_dstream || ZSTD_isError(::ZSTD_initDStream(m_dstream)))
+            throw input_reader_exception{m_compressed.file().error("decompress")};
+    }
+
+    ~zstd_source() noexcept override { ::ZSTD_freeDStream(m_dstream); }
+
+    std::size_t produce(char *dest, std::size_t max) override {
+        ZSTD_outBuffer out{dest, max, 0};
+        while (out.pos < out.size) {
+            if (m_input.pos == m_input.size) {
+                const std::size_t count = m_compressed.produce(m_in.get(), ZSTD_DStreamInSize());
+                if (count == 0) {
+                    if (!m_frame_ended)
+                        throw input_reader_exception{m_compressed.file().error("decompress the truncated")};
+                    break;
+                }
+                m_input = ZSTD_inBuffer{m_in.get(), count, 0};
+            }
+
+            const std::size_t rc = ::ZSTD_decompressStream(m_dstream, &out, &m_input);
+            if (ZSTD_isError(rc))
+                throw input_reader_exception{m_compressed.file().error("decompress the corrupted")};
+            // Zero means that a frame has just been completed. Another one may follow.
+            m_frame_ended = rc == 0;
+        }
+        return out.pos;
+    }
+
+private:
+    file_source m_compressed;
+    std::unique_ptr<char[]> m_in;
+    ZSTD_DStream *m_dstream;
+    ZSTD_inBuffer m_input{nullptr, 0, 0};
+    bool m_frame_ended{false};
+};
+#endif
+
+}
+
+///
+/// Runs a `block_source` on a background thread which keeps a couple of blocks ready
+/// ahead of the reader.
+///
+class prefetcher {
+public:
+    prefetcher(std::unique_ptr<block_source> source, std::size_t block_size)
+        : m_source{std::move(source)}
+        , m_block_size{block_size} {
+        for (auto &b : m_blocks)
+            b.data = std::make_unique<char[]>(m_block_size);
+        m_thread = std::thread{[this] { run(); }};
+    }
+
+    ~prefetcher() noexcept {
+        // Wake the producer up in case it waits for a free block.
+        m_stop = true;
+        m_free.release();
+        m_thread.join();
+    }
+
+    // Hands the prefetched input to the reader. Blocks until there is something to hand.
+    std::size_t read(char *dest, std::size_t max) {
+        if (!m_holding) {
+            if (m_finished)
+                return 0;
+            m_ready.acquire();
+            m_holding = true;
+        }
+
+        const block &b = m_blocks[m_head];
+        if (b.len == 0) {
+            // The last block is never given back, so the producer stays stopped.
+            m_finished = true;
+            m_holding = false;
+            if (!m_error.empty())
+                throw input_reader_exception{m_error};
+            return 0;
+        }
+
+        const std::size_t count = std::min(max, b.len - m_offset);
+        std::memcpy(dest, b.data.get() + m_offset, count);
+        m_offset += count;
+
+        if (m_offset == b.len) {
+            m_offset = 0;
+            m_head = (m_head + 1) % num_blocks;
+            m_holding = false;
+            m_free.release();
+        }
+        return count;
+    }
+
+private:
+    // The producer fills the free blocks in order while the reader goes through the ready ones.
+    // An empty block marks the end of the input (or an error).
+    void run() {
+        for (std::size_t slot = 0;; slot = (slot + 1) % num_blocks) {
+            m_free.acquire();
+            if (m_stop)
+                return;
+
+            block &b = m_blocks[slot];
+            try {
+                b.len = m_source->produce(b.data.get(), m_block_size);
+            } catch (const std::exception &e) {
+                b.len = 0;
+                m_error = e.what();
+            }
+
+            m_ready.release();
+            if (b.len == 0)
+                return;
+        }
+    }
+
+    static constexpr std::size_t num_blocks = 3;
+
+    struct block {
+        std::unique_ptr<char[]> data;
+        std::size_t len{0};
+    };
+
+    std::unique_ptr<block_source> m_source;
+    std::size_t m_block_size;
+
+    block m_blocks[num_blocks];
+    std::counting_semaphore<> m_free{num_blocks};
+    std::counting_semaphore<> m_ready{0};
+    std::atomic<bool> m_stop{false};
+
+    // Written by the producer before it hands over the last block.
+    std::string m_error;
+
+    // Only touched by the reader.
+    std::size_t m_head{0};
+    std::size_t m_offset{0};
+    bool m_holding{false};
+    bool m_finished{false};
+
+    std::thread m_thread;
+};
+
+}
+
+///
+/// compressed_input_reader
+///
+
+namespace {
+
+compressed_input_reader::codec detect_codec(const unsigned char *magic, std::size_t size) {
+    using codec = compressed_input_reader::codec;
+    if (size >= 2 && magic[0] == 0x1f && magic[1] == 0x8b)
+        return codec::gzip;
+    // A zlib header is 0x78 followed by a byte which makes the pair divisible by 31.
+    if (size >= 2 && magic[0] == 0x78 && ((magic[0] << 8) | magic[1]) % 31 == 0)
+        return codec::gzip;
+    if (size >= 4 && magic[0] == 0x28 && magic[1] == 0xb5 && magic[2] == 0x2f && magic[3] == 0xfd)
+        return codec::zstd;
+    return codec::none;
+}
+
+}
+
+compressed_input_reader::compressed_input_reader(const std::string &filename, std::size_t window_size)
+    : m_window{window_size} {
+    auto file = detail::open_regular_file(filename, kind());
+    if (window_size == 0)
+        throw input_reader_exception{"Cannot use input '" + filename + "' of type `compressed_input_reader` with an empty window."};
+
+    unsigned char magic[4];
+    ssize_t magic_size;
+    do {
+        magic_size = ::pread(file->fd, magic, sizeof(magic), 0);
+    } while (magic_size < 0 && errno == EINTR);
+    if (magic_size < 0)
+        throw input_reader_exception{file->error("read from")};
+
+    m_codec = detect_codec(magic, static_cast<std::size_t>(magic_size));
+
+    std::unique_ptr<detail::block_source> source;
+    switch (m_codec) {
+    case codec::gzip:
+        source = std::make_unique<detail::gzip_source>(std::move(file));
+        break;
+    case codec::zstd:
+#ifdef FMI_JSON_PARSER_HAVE_ZSTD
+        source = std::make_unique<detail::zstd_source>(std::move(file));
+        break;
+#else
+        throw input_reader_exception{"Cannot decompress zstd input '" + filename + "' of type `compressed_input_reader` as zstd support is not built in."};
+#endif
+    default:
+        source = std::make_unique<detail::file_source>(std::move(file), 0);
+        break;
+    }
+
+    m_prefetcher = std::make_unique<detail::prefetcher>(std::move(source), block_size);
+}
+
+compressed_input_reader::~compressed_input_reader() noexcept = default;
+
+compressed_input_reader::compressed_input_reader(compressed_input_reader &&) noexcept = default;
+
+compressed_input_reader& compressed_input_reader::operator=(compressed_input_reader &&) noexcept = default;
+
+bool compressed_input_reader::supports_zstd() noexcept {
+#ifdef FMI_JSON_PARSER_HAVE_ZSTD
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool compressed_input_reader::fill(std::size_t n) const {
+    if (m_pos < m_window.begin_pos())
+        throw input_reader_exception("Cannot seek backwards in input of type `compressed_input_reader`.");
+
+    return m_window.slide(m_pos, n, [this](char *dest, std::size_t max) { return m_prefetcher->read(dest, max); });
+}
+
+///
+/// async_input_reader
+///
+
+async_input_reader::async_input_reader(const std::string &filename, std::size_t window_size)
+    : m_window{window_size} {
+    m_file = detail::open_regular_file(filename, kind(), &m_size);
+    if (window_size == 0)
+        throw input_reader_exception{"Cannot use input '" + filename + "' of type `async_input_reader` with an empty window."};
+    // Start reading right away, so that the first block is likely ready once it is needed.
+    restart(0);
+}
+
+async_input_reader::async_input_reader(const async_input_reader &rhs)
+    : m_file{rhs.m_file}
+    , m_size{rhs.m_size}
+    , m_window{rhs.m_window.capacity()}
+    , m_pos{rhs.m_pos} { }
+
+async_input_reader& async_input_reader::operator=(const async_input_reader &rhs) {
+    m_prefetcher.reset();
+    m_file = rhs.m_file;
+    m_size = rhs.m_size;
+    m_window = sliding_window{rhs.m_window.capacity()};
+    m_pos = rhs.m_pos;
+    return *this;
+}
+
+async_input_reader::~async_input_reader() noexcept = default;
+
+async_input_reader::async_input_reader(async_input_reader &&) noexcept = default;
+
+async_input_reader& async_input_reader::operator=(async_input_reader &&) noexcept = default;
+
+void async_input_reader::restart(pos_type pos) const {
+    // The old producer has to be stopped before the window is touched.
+    m_prefetcher.reset();
+    m_window.reset(pos);
+    m_prefetcher = std::make_unique<detail::prefetcher>(std::make_unique<detail::file_source>(m_file, pos), block_size);
+}
+
+bool async_input_reader::fill(std::size_t n) const {
+    if (!(m_pos < m_size))
+        return false;
+    // Unlike the streams, a file can be read again from anywhere.
+    if (!m_prefetcher || m_pos < m_window.begin_pos())
+        restart(m_pos);
+
+    return m_window.slide(m_pos, n, [this](char *dest, std::size_t max) { return m_prefetcher->read(dest, max); });
+}
+
+}
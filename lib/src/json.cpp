@@ -37,10 +37,9 @@ namespace json_parser {
             if (!component_as_num)
                 throw json_exception(int_error_msg);
 
-            const double num = (double) *component_as_num;
-            const std::size_t index = static_cast<std::size_t>(num);
-            if ((double) index != num)
+            if (!component_as_num->fits_uint64())
                 throw json_exception(int_error_msg);
+            const std::uint64_t index = component_as_num->uint64_value();
             try {
                 node_ptr = &node_as_array->m_data.at(index);
             } catch (const std::out_of_range &oor) {
@@ -84,10 +83,9 @@ namespace json_parser {
             if (!component_as_num)
                 throw json_exception(int_error_msg);
 
-            const double num = (double) *component_as_num;
-            const std::size_t index = static_cast<std::size_t>(num);
-            if ((double) index != num)
+            if (!component_as_num->fits_uint64())
                 throw json_exception(int_error_msg);
+            const std::uint64_t index = component_as_num->uint64_value();
             try {
                 node_ptr = &node_as_array->m_data.at(index);
             } catch (const std::out_of_range &oor) {
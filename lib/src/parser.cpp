@@ -3,4 +3,88 @@
 
 namespace json_parser {
 
+namespace {
+
+// The tokens on a tape, for the grammar (see `detail::event_parser`). If the tape ends with
+// an error, it comes up only once the grammar goes past the last token - just as the token
+// iterator runs into it only when it gets there.
+class tape_tokens {
+public:
+    explicit tape_tokens(const token_tape &tape) noexcept
+        : m_tape{tape} {}
+
+    [[nodiscard]] bool at_end() const noexcept { return m_tape.empty() && !m_tape.failed(); }
+
+    // The same as `token_citerator::has_more()` - whether there is any input after the current
+    // token, which is read as soon as the one before it is consumed (but the first one is not
+    // read until it is needed). What the error is in is input as well.
+    [[nodiscard]] bool has_more() const noexcept {
+        if (!(m_next < m_tape.size()))
+            return m_tape.failed();
+        const tape_entry &entry = m_tape[m_next];
+        return m_next == 0 || m_tape.failed() || entry.offset + entry.length < m_tape.input_end();
+    }
+
+    [[nodiscard]] token_value *current() noexcept {
+        if (!(m_next < m_tape.size()))
+            return nullptr;
+        if (m_loaded != m_next) {
+            load(m_tape[m_next]);
+            m_loaded = m_next;
+        }
+        return &m_current;
+    }
+
+    [[nodiscard]] bool advance() noexcept {
+        if (m_next < m_tape.size())
+            ++m_next;
+        return !failed();
+    }
+
+    [[nodiscard]] bool failed() const noexcept { return !(m_next < m_tape.size()) && m_tape.failed(); }
+    [[nodiscard]] const parse_error &error() const noexcept { return m_tape.error(); }
+
+    // The tape knows where its tokens are, but not on which line.
+    [[nodiscard]] location where() const noexcept {
+        if (m_next < m_tape.size())
+            return location{m_tape[m_next].offset};
+        if (m_tape.empty())
+            return location{0};
+        const tape_entry &last = m_tape[m_tape.size() - 1];
+        return location{last.offset + last.length};
+    }
+
+private:
+    // The strings refer to the tape, which outlives the parsing.
+    void load(const tape_entry &entry) noexcept {
+        switch (entry.kind) {
+            // clang-format off
+            break; case token_value::kind::Punct: m_current.set_punct(entry.punct);
+            break; case token_value::kind::Keyword: m_current.set_keyword(entry.keyword);
+            break; case token_value::kind::Number: m_current.set_number(m_tape.number(entry));
+            break; case token_value::kind::String: m_current.set_borrowed_string(m_tape.string(entry));
+            // clang-format on
+        }
+    }
+
+private:
+    const token_tape &m_tape;
+    std::size_t m_next{0};
+
+    // The current token, as `current()` gives it - and which entry it is.
+    token_value m_current;
+    std::size_t m_loaded{token_tape::npos};
+};
+
+}
+
+json parse_tape(const token_tape &tape, std::size_t max_depth) {
+    tape_tokens tokens{tape};
+    detail::event_parser events{tokens, max_depth};
+    dom_builder builder;
+    if (!events.parse(builder))
+        throw parser_exception(std::move(events.error().message), events.error().where);
+    return builder.take();
+}
+
 }
@@ -0,0 +1,186 @@
+#include <atomic>
+
+#include <json-parser/simd.h>
+
+#include "simd_kernels.h"
+
+namespace json_parser::simd {
+
+///
+/// The scalar kernels
+///
+
+namespace detail {
+
+namespace {
+
+// Works on 8 bytes at a time within a plain 64-bit word (SWAR).
+struct scalar_block {
+    static scalar_block load(const char *data) {
+        scalar_block b;
+        std::memcpy(b.words, data, block_size);
+        return b;
+    }
+
+    std::uint64_t eq(char sym) const {
+        constexpr std::uint64_t ones = 0x0101010101010101ULL;
+        constexpr std::uint64_t low7 = 0x7f7f7f7f7f7f7f7fULL;
+        const std::uint64_t needle = ones * static_cast<unsigned char>(sym);
+
+        std::uint64_t bits = 0;
+        for (std::size_t i = 0; i < 8; ++i) {
+            // The high bit of each byte is set if the byte is zero, i.e. equal to `sym`.
+            const std::uint64_t x = words[i] ^ needle;
+            const std::uint64_t zero = ~(((x & low7) + low7) | x | low7);
+            // Gathers the high bits into the lowest byte.
+            bits |= (((zero >> 7) * 0x0102040810204080ULL) >> 56) << (8 * i);
+        }
+        return bits;
+    }
+
+    static std::uint64_t prefix_xor(std::uint64_t bits) {
+        bits ^= bits << 1;
+        bits ^= bits << 2;
+        bits ^= bits << 4;
+        bits ^= bits << 8;
+        bits ^= bits << 16;
+        bits ^= bits << 32;
+        return bits;
+    }
+
+    bool ascii() const {
+        std::uint64_t all = 0;
+        for (std::uint64_t word : words)
+            all |= word;
+        return (all & 0x8080808080808080ULL) == 0;
+    }
+
+    bool utf8_errors(const scalar_block &prev) const {
+        // The last three bytes of the previous block come first.
+        unsigned char bytes[3 + block_size];
+        std::memcpy(bytes, reinterpret_cast<const unsigned char *>(prev.words) + block_size - 3, 3);
+        std::memcpy(bytes + 3, words, block_size);
+
+        std::uint8_t errors = 0;
+        for (std::size_t i = 3; i < 3 + block_size; ++i) {
+            const std::uint8_t prev1 = bytes[i - 1];
+            const std::uint8_t special = utf8::byte_1_high[prev1 >> 4] & utf8::byte_1_low[prev1 & 0x0f]
+                                         & utf8::byte_2_high[bytes[i] >> 4];
+            errors |= special ^ utf8::must_be_continuation(bytes[i - 2], bytes[i - 3]);
+        }
+        return errors != 0;
+    }
+
+    // Safety: The byte order of the words matches the one of the input only on little-endian.
+    static_assert(std::endian::native == std::endian::little);
+
+    std::uint64_t words[block_size / 8];
+};
+
+}
+
+const kernel_table scalar_kernels = make_kernel_table<scalar_block>();
+
+}
+
+///
+/// Dispatch
+///
+
+namespace {
+
+bool supported(isa which) noexcept {
+    switch (which) {
+    case isa::scalar:
+        return true;
+#ifdef FMI_JSON_PARSER_HAVE_X86_KERNELS
+    case isa::sse42:
+        return __builtin_cpu_supports("sse4.2") && __builtin_cpu_supports("pclmul");
+    case isa::avx2:
+        return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("pclmul");
+#endif
+    default:
+        return false;
+    }
+}
+
+const detail::kernel_table &table_of(isa which) noexcept {
+    switch (which) {
+#ifdef FMI_JSON_PARSER_HAVE_X86_KERNELS
+    case isa::sse42:
+        return detail::sse42_kernels;
+    case isa::avx2:
+        return detail::avx2_kernels;
+#endif
+    default:
+        return detail::scalar_kernels;
+    }
+}
+
+isa best_supported() noexcept {
+    for (isa which : {isa::avx2, isa::sse42})
+        if (supported(which))
+            return which;
+    return isa::scalar;
+}
+
+std::atomic<isa> g_active{best_supported()};
+
+const detail::kernel_table &active() noexcept {
+    return table_of(g_active.load(std::memory_order_relaxed));
+}
+
+}
+
+isa active_isa() noexcept {
+    return g_active.load(std::memory_order_relaxed);
+}
+
+bool select_isa(isa which) noexcept {
+    if (!supported(which))
+        return false;
+    g_active.store(which, std::memory_order_relaxed);
+    return true;
+}
+
+const char *isa_name(isa which) noexcept {
+    switch (which) {
+    case isa::sse42:
+        return "sse4.2";
+    case isa::avx2:
+        return "avx2";
+    default:
+        return "scalar";
+    }
+}
+
+void index_structurals(std::span<const char> input, std::vector<std::uint32_t> &positions) {
+    active().index_structurals(input.data(), input.size(), positions, nullptr);
+}
+
+void index_structurals(std::span<const char> input, std::vector<std::uint32_t> &positions,
+                       std::vector<std::uint32_t> &line_breaks) {
+    active().index_structurals(input.data(), input.size(), positions, &line_breaks);
+}
+
+std::size_t scan_whitespace(std::span<const char> input, std::size_t max) {
+    return active().scan_whitespace(input.data(), input.size(), max);
+}
+
+std::size_t scan_string(std::span<const char> input) {
+    return active().scan_string(input.data(), input.size());
+}
+
+bool validate_utf8(std::span<const char> input) {
+    // Most strings are short and plain ASCII, which is cheaper to see right away.
+    if (input.size() < detail::block_size) {
+        unsigned char all = 0;
+        for (char sym : input)
+            all |= static_cast<unsigned char>(sym);
+        if (all < 0x80)
+            return true;
+    }
+    return active().validate_utf8(input.data(), input.size());
+}
+
+}
@@ -0,0 +1,74 @@
+// Compiled with -mavx2 -mpclmul. Used only if the CPU supports them.
+
+#include <immintrin.h>
+
+#include "simd_kernels.h"
+
+namespace json_parser::simd::detail {
+
+namespace {
+
+struct avx2_block {
+    static avx2_block load(const char *data) {
+        return avx2_block{
+            _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data)),
+            _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + 32)),
+        };
+    }
+
+    std::uint64_t eq(char sym) const {
+        const __m256i needle = _mm256_set1_epi8(sym);
+        const auto lo = static_cast<std::uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(lo_half, needle)));
+        const auto hi = static_cast<std::uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(hi_half, needle)));
+        return static_cast<std::uint64_t>(hi) << 32 | lo;
+    }
+
+    // Carry-less multiplication by all ones is exactly the prefix xor.
+    static std::uint64_t prefix_xor(std::uint64_t bits) {
+        const __m128i all_ones = _mm_set1_epi8(static_cast<char>(0xff));
+        const __m128i result = _mm_clmulepi64_si128(_mm_set_epi64x(0, static_cast<long long>(bits)), all_ones, 0);
+        return static_cast<std::uint64_t>(_mm_cvtsi128_si64(result));
+    }
+
+    bool ascii() const {
+        return _mm256_movemask_epi8(_mm256_or_si256(lo_half, hi_half)) == 0;
+    }
+
+    bool utf8_errors(const avx2_block &prev) const {
+        const __m256i byte_1_high = _mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i *>(utf8::byte_1_high)));
+        const __m256i byte_1_low = _mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i *>(utf8::byte_1_low)));
+        const __m256i byte_2_high = _mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i *>(utf8::byte_2_high)));
+        const __m256i low_nibble = _mm256_set1_epi8(0x0f);
+        auto high_nibble = [&](__m256i x) { return _mm256_and_si256(_mm256_srli_epi16(x, 4), low_nibble); };
+
+        auto check = [&](__m256i current, __m256i before) {
+            // The shuffles work within the 128-bit lanes, so the bytes before each lane are put
+            // next to it first.
+            const __m256i lanes_before = _mm256_permute2x128_si256(before, current, 0x21);
+            const __m256i prev1 = _mm256_alignr_epi8(current, lanes_before, 15);
+            const __m256i special = _mm256_and_si256(
+                _mm256_and_si256(_mm256_shuffle_epi8(byte_1_high, high_nibble(prev1)),
+                                 _mm256_shuffle_epi8(byte_1_low, _mm256_and_si256(prev1, low_nibble))),
+                _mm256_shuffle_epi8(byte_2_high, high_nibble(current)));
+
+            // Only the bytes at or past 0xe0 (0xf0) stay at or past 0x80.
+            const __m256i third = _mm256_subs_epu8(_mm256_alignr_epi8(current, lanes_before, 14), _mm256_set1_epi8(static_cast<char>(0xe0 - 0x80)));
+            const __m256i fourth = _mm256_subs_epu8(_mm256_alignr_epi8(current, lanes_before, 13), _mm256_set1_epi8(static_cast<char>(0xf0 - 0x80)));
+            const __m256i must_be_continuation = _mm256_and_si256(_mm256_or_si256(third, fourth), _mm256_set1_epi8(static_cast<char>(0x80)));
+
+            return _mm256_xor_si256(must_be_continuation, special);
+        };
+
+        const __m256i errors = _mm256_or_si256(check(lo_half, prev.hi_half), check(hi_half, lo_half));
+        return !_mm256_testz_si256(errors, errors);
+    }
+
+    __m256i lo_half;
+    __m256i hi_half;
+};
+
+}
+
+const kernel_table avx2_kernels = make_kernel_table<avx2_block>();
+
+}
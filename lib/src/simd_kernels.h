@@ -0,0 +1,313 @@
+#ifndef FMI_JSON_PARSER_SIMD_KERNELS_INCLUDED
+#define FMI_JSON_PARSER_SIMD_KERNELS_INCLUDED
+
+// This header is private to the library. It holds the kernels written once over an abstract
+// 64-byte block and is included by each of the `simd_*.cpp` files, which are compiled with
+// the flags of their instruction set and provide the block type for it.
+// Everything but the kernel tables lives in an anonymous namespace on purpose - the same
+// templates get compiled with different instructions in each file and they must not be
+// merged by the linker.
+
+#include <bit>
+#include <algorithm>
+#include <vector>
+#include <cstdint>
+#include <cstring>
+
+#include <json-parser/simd.h>
+
+namespace json_parser::simd::detail {
+
+struct kernel_table {
+    void (*index_structurals)(const char *data, std::size_t size, std::vector<std::uint32_t> &positions,
+                              std::vector<std::uint32_t> *line_breaks);
+    std::size_t (*scan_whitespace)(const char *data, std::size_t size, std::size_t max);
+    std::size_t (*scan_string)(const char *data, std::size_t size);
+    bool (*validate_utf8)(const char *data, std::size_t size);
+};
+
+extern const kernel_table scalar_kernels;
+#ifdef FMI_JSON_PARSER_HAVE_X86_KERNELS
+extern const kernel_table sse42_kernels;
+extern const kernel_table avx2_kernels;
+#endif
+
+namespace {
+
+///
+/// Each of the instruction sets provides a block type which looks like this:
+///
+///     struct block {
+///         static block load(const char *data);          // Loads 64 bytes.
+///         std::uint64_t eq(char sym) const;             // Bit i is set if byte i is `sym`.
+///         static std::uint64_t prefix_xor(std::uint64_t bits);
+///         bool ascii() const;                           // No byte has its high bit set.
+///         bool utf8_errors(const block &prev) const;    // See `validate_utf8`.
+///     };
+///
+
+constexpr std::size_t block_size = 64;
+
+// Calls `fn` with every 64-byte block of the input and the offset it starts at until it
+// returns false. The last block is padded with spaces.
+template <typename Block, typename Fn>
+inline void for_each_block(const char *data, std::size_t size, Fn &&fn) {
+    std::size_t i = 0;
+    for (; i + block_size <= size; i += block_size)
+        if (!fn(Block::load(data + i), i))
+            return;
+    if (i < size) {
+        char tail[block_size];
+        std::memset(tail, ' ', block_size);
+        std::memcpy(tail, data + i, size - i);
+        fn(Block::load(tail), i);
+    }
+}
+
+template <typename Block>
+inline std::uint64_t whitespace(const Block &b) {
+    // The same ones as `std::isspace` in the "C" locale.
+    return b.eq(' ') | b.eq('\n') | b.eq('\t') | b.eq('\r') | b.eq('\v') | b.eq('\f');
+}
+
+template <typename Block>
+inline std::uint64_t punctuators(const Block &b) {
+    return b.eq('{') | b.eq('}') | b.eq('[') | b.eq(']') | b.eq(':') | b.eq(',');
+}
+
+// Finds the symbols which are escaped, i.e. preceded by an odd number of backslashes.
+// `carry` tells whether the first symbol of the block is escaped by the previous one.
+inline std::uint64_t find_escaped(std::uint64_t backslash, std::uint64_t &carry) {
+    constexpr std::uint64_t even_bits = 0x5555555555555555ULL;
+
+    // A backslash escaped by the previous block does not start a sequence.
+    backslash &= ~carry;
+    const std::uint64_t follows_escape = (backslash << 1) | carry;
+
+    // Adding a sequence's start to it carries past its end - the parity of where it started
+    // and where it ended tells whether the sequence is odd.
+    const std::uint64_t odd_sequence_starts = backslash & ~even_bits & ~follows_escape;
+    std::uint64_t sequences_starting_on_even_bits;
+    carry = __builtin_add_overflow(odd_sequence_starts, backslash, &sequences_starting_on_even_bits);
+    const std::uint64_t invert_mask = sequences_starting_on_even_bits << 1;
+
+    return (even_bits ^ invert_mask) & follows_escape;
+}
+
+inline void flatten(std::uint64_t bits, std::size_t base, std::vector<std::uint32_t> &positions) {
+    while (bits) {
+        positions.push_back(static_cast<std::uint32_t>(base + std::countr_zero(bits)));
+        bits &= bits - 1;
+    }
+}
+
+// The same as `flatten`, with the kind of each line break in the top bits.
+inline void flatten_line_breaks(std::uint64_t newlines, std::uint64_t carriage_returns, std::uint64_t tabs,
+                                std::size_t base, std::vector<std::uint32_t> &line_breaks) {
+    std::uint64_t bits = newlines | carriage_returns | tabs;
+    while (bits) {
+        const int i = std::countr_zero(bits);
+        const auto kind = static_cast<std::uint32_t>(((carriage_returns >> i) & 1) | (((tabs >> i) & 1) << 1));
+        line_breaks.push_back(static_cast<std::uint32_t>(base + i) | kind << line_break_shift);
+        bits &= bits - 1;
+    }
+}
+
+template <typename Block>
+void index_structurals(const char *data, std::size_t size, std::vector<std::uint32_t> &positions,
+                       std::vector<std::uint32_t> *line_breaks) {
+    std::uint64_t escaped_carry = 0;
+    std::uint64_t in_string_carry = 0;
+    std::uint64_t scalar_carry = 0;
+
+    for_each_block<Block>(data, size, [&](const Block &b, std::size_t base) {
+        const std::uint64_t escaped = find_escaped(b.eq('\\'), escaped_carry);
+        const std::uint64_t quote = b.eq('"') & ~escaped;
+
+        // Everything from an opening quote up to (but without) the closing one.
+        const std::uint64_t in_string = Block::prefix_xor(quote) ^ in_string_carry;
+        in_string_carry = static_cast<std::uint64_t>(static_cast<std::int64_t>(in_string) >> 63);
+
+        const std::uint64_t newlines = b.eq('\n');
+        const std::uint64_t carriage_returns = b.eq('\r');
+        const std::uint64_t tabs = b.eq('\t');
+        const std::uint64_t punct = punctuators(b);
+        const std::uint64_t scalar = ~(punct | newlines | carriage_returns | tabs | b.eq(' ') | b.eq('\v') | b.eq('\f'));
+
+        // Numbers and keywords start where a run of such symbols starts. A quote right after
+        // one does not start a string - it is just a symbol the tokenizer will complain about.
+        const std::uint64_t nonquote_scalar = scalar & ~quote;
+        const std::uint64_t follows_scalar = (nonquote_scalar << 1) | scalar_carry;
+        scalar_carry = nonquote_scalar >> 63;
+        const std::uint64_t scalar_starts = scalar & ~follows_scalar;
+
+        // The opening quotes stay, the rest of the strings (with the closing quotes) does not.
+        flatten((punct | scalar_starts) & ~(in_string ^ quote), base, positions);
+
+        // Nothing in a string moves to another line - not even a (raw) newline.
+        if (line_breaks && ((newlines | carriage_returns | tabs) & ~in_string))
+            flatten_line_breaks(newlines & ~in_string, carriage_returns & ~in_string, tabs & ~in_string, base, *line_breaks);
+        return true;
+    });
+}
+
+template <typename Block>
+std::size_t scan_whitespace(const char *data, std::size_t size, std::size_t max) {
+    std::size_t run = 0;
+    max = std::min(max, size);
+
+    for_each_block<Block>(data, size, [&](const Block &b, std::size_t base) {
+        if (!(base < max))
+            return false;
+
+        // The run stops at the first symbol which is not whitespace or is past `max`.
+        const std::uint64_t allowed = max - base < block_size ? (std::uint64_t{1} << (max - base)) - 1 : ~std::uint64_t{0};
+        const std::uint64_t stops = ~(whitespace(b) & allowed);
+        const int length = std::countr_zero(stops);
+
+        run = base + static_cast<std::size_t>(length);
+        return length == 64;
+    });
+
+    return run;
+}
+
+template <typename Block>
+std::size_t scan_string(const char *data, std::size_t size) {
+    std::size_t end = size;
+    // The padding of the last block is spaces, so nothing past the input is ever found.
+    for_each_block<Block>(data, size, [&](const Block &b, std::size_t base) {
+        const std::uint64_t stops = b.eq('"') | b.eq('\\');
+        if (!stops)
+            return true;
+        end = base + static_cast<std::size_t>(std::countr_zero(stops));
+        return false;
+    });
+    return end;
+}
+
+///
+/// UTF-8 validation after "Validating UTF-8 In Less Than One Instruction Per Byte" by Keiser
+/// and Lemire. Almost every error shows up in the high nibble of a byte together with both
+/// nibbles of the one before it, so the three nibbles are looked up in the tables below and
+/// the results are and-ed - a bit which survives is an error. What is left is checking that
+/// the third and fourth bytes of the long sequences are continuations - `two_continuations`
+/// is set for them on purpose and is cancelled out by `must_be_continuation`.
+///
+namespace utf8 {
+
+constexpr std::uint8_t too_short = 1 << 0;
+constexpr std::uint8_t too_long = 1 << 1;
+constexpr std::uint8_t overlong_3 = 1 << 2;
+constexpr std::uint8_t too_large = 1 << 3;
+constexpr std::uint8_t surrogate = 1 << 4;
+constexpr std::uint8_t overlong_2 = 1 << 5;
+constexpr std::uint8_t too_large_1000 = 1 << 6;
+constexpr std::uint8_t overlong_4 = 1 << 6;
+constexpr std::uint8_t two_continuations = 1 << 7;
+constexpr std::uint8_t carry = too_short | too_long | two_continuations;
+
+// Looked up by the high nibble of the previous byte.
+constexpr std::uint8_t byte_1_high[16] = {
+    // 0xxx____ - ASCII
+    too_long, too_long, too_long, too_long, too_long, too_long, too_long, too_long,
+    // 10xx____ - continuation
+    two_continuations, two_continuations, two_continuations, two_continuations,
+    // 1100____ - 2-byte lead (and 0xc0, 0xc1 are always overlong)
+    too_short | overlong_2,
+    // 1101____ - 2-byte lead
+    too_short,
+    // 1110____ - 3-byte lead
+    too_short | overlong_3 | surrogate,
+    // 1111____ - 4-byte lead (or nothing at all)
+    too_short | too_large | too_large_1000 | overlong_4,
+};
+
+// Looked up by the low nibble of the previous byte.
+constexpr std::uint8_t byte_1_low[16] = {
+    carry | overlong_3 | overlong_2 | overlong_4,
+    carry | overlong_2,
+    carry,
+    carry,
+    carry | too_large,
+    carry | too_large | too_large_1000,
+    carry | too_large | too_large_1000,
+    carry | too_large | too_large_1000,
+    carry | too_large | too_large_1000,
+    carry | too_large | too_large_1000,
+    carry | too_large | too_large_1000,
+    carry | too_large | too_large_1000,
+    carry | too_large | too_large_1000,
+    carry | too_large | too_large_1000 | surrogate,
+    carry | too_large | too_large_1000,
+    carry | too_large | too_large_1000,
+};
+
+// Looked up by the high nibble of the current byte.
+constexpr std::uint8_t byte_2_high[16] = {
+    // 0xxx____ - ASCII
+    too_short, too_short, too_short, too_short, too_short, too_short, too_short, too_short,
+    // 1000____
+    too_long | overlong_2 | two_continuations | overlong_3 | too_large_1000 | overlong_4,
+    // 1001____
+    too_long | overlong_2 | two_continuations | overlong_3 | too_large,
+    // 101x____
+    too_long | overlong_2 | two_continuations | surrogate | too_large,
+    too_long | overlong_2 | two_continuations | surrogate | too_large,
+    // 11xx____ - a lead
+    too_short, too_short, too_short, too_short,
+};
+
+// The bytes right after the lead of a 3- or 4-byte sequence are already checked by the tables,
+// the ones after that are not. The high bit is set where a continuation has to be.
+constexpr std::uint8_t must_be_continuation(std::uint8_t prev2, std::uint8_t prev3) {
+    const bool third = prev2 >= 0xe0;
+    const bool fourth = prev3 >= 0xf0;
+    return third || fourth ? 0x80 : 0;
+}
+
+}
+
+// Whether `data` is whole and valid UTF-8. The blocks which are entirely ASCII (and follow
+// another such block) are only looked at once.
+template <typename Block>
+bool validate_utf8(const char *data, std::size_t size) {
+    char tail[block_size];
+    std::memset(tail, ' ', block_size);
+
+    Block prev = Block::load(tail);
+    bool prev_ascii = true;
+    auto has_errors = [&](const Block &b) {
+        const bool ascii = b.ascii();
+        const bool errors = !(ascii && prev_ascii) && b.utf8_errors(prev);
+        prev = b;
+        prev_ascii = ascii;
+        return errors;
+    };
+
+    std::size_t i = 0;
+    for (; i + block_size <= size; i += block_size)
+        if (has_errors(Block::load(data + i)))
+            return false;
+
+    // The last block is padded with spaces and checked even if it is just padding, so that
+    // a sequence cut short at the very end is not missed.
+    std::memcpy(tail, data + i, size - i);
+    return !has_errors(Block::load(tail));
+}
+
+template <typename Block>
+constexpr kernel_table make_kernel_table() {
+    return kernel_table{
+        .index_structurals = &index_structurals<Block>,
+        .scan_whitespace = &scan_whitespace<Block>,
+        .scan_string = &scan_string<Block>,
+        .validate_utf8 = &validate_utf8<Block>,
+    };
+}
+
+}
+
+}
+
+#endif // FMI_JSON_PARSER_SIMD_KERNELS_INCLUDED
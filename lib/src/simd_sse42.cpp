@@ -0,0 +1,75 @@
+// Compiled with -msse4.2 -mpclmul. Used only if the CPU supports them.
+
+#include <immintrin.h>
+
+#include "simd_kernels.h"
+
+namespace json_parser::simd::detail {
+
+namespace {
+
+struct sse42_block {
+    static sse42_block load(const char *data) {
+        sse42_block b;
+        for (int i = 0; i < 4; ++i)
+            b.chunks[i] = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + 16 * i));
+        return b;
+    }
+
+    std::uint64_t eq(char sym) const {
+        const __m128i needle = _mm_set1_epi8(sym);
+        std::uint64_t bits = 0;
+        for (int i = 0; i < 4; ++i) {
+            const auto mask = static_cast<std::uint16_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(chunks[i], needle)));
+            bits |= static_cast<std::uint64_t>(mask) << (16 * i);
+        }
+        return bits;
+    }
+
+    // Carry-less multiplication by all ones is exactly the prefix xor.
+    static std::uint64_t prefix_xor(std::uint64_t bits) {
+        const __m128i all_ones = _mm_set1_epi8(static_cast<char>(0xff));
+        const __m128i result = _mm_clmulepi64_si128(_mm_set_epi64x(0, static_cast<long long>(bits)), all_ones, 0);
+        return static_cast<std::uint64_t>(_mm_cvtsi128_si64(result));
+    }
+
+    bool ascii() const {
+        const __m128i all = _mm_or_si128(_mm_or_si128(chunks[0], chunks[1]), _mm_or_si128(chunks[2], chunks[3]));
+        return _mm_movemask_epi8(all) == 0;
+    }
+
+    bool utf8_errors(const sse42_block &prev) const {
+        const __m128i byte_1_high = _mm_loadu_si128(reinterpret_cast<const __m128i *>(utf8::byte_1_high));
+        const __m128i byte_1_low = _mm_loadu_si128(reinterpret_cast<const __m128i *>(utf8::byte_1_low));
+        const __m128i byte_2_high = _mm_loadu_si128(reinterpret_cast<const __m128i *>(utf8::byte_2_high));
+        const __m128i low_nibble = _mm_set1_epi8(0x0f);
+        auto high_nibble = [&](__m128i x) { return _mm_and_si128(_mm_srli_epi16(x, 4), low_nibble); };
+
+        __m128i errors = _mm_setzero_si128();
+        __m128i before = prev.chunks[3];
+        for (const __m128i &current : chunks) {
+            const __m128i prev1 = _mm_alignr_epi8(current, before, 15);
+            const __m128i special = _mm_and_si128(
+                _mm_and_si128(_mm_shuffle_epi8(byte_1_high, high_nibble(prev1)),
+                              _mm_shuffle_epi8(byte_1_low, _mm_and_si128(prev1, low_nibble))),
+                _mm_shuffle_epi8(byte_2_high, high_nibble(current)));
+
+            // Only the bytes at or past 0xe0 (0xf0) stay at or past 0x80.
+            const __m128i third = _mm_subs_epu8(_mm_alignr_epi8(current, before, 14), _mm_set1_epi8(static_cast<char>(0xe0 - 0x80)));
+            const __m128i fourth = _mm_subs_epu8(_mm_alignr_epi8(current, before, 13), _mm_set1_epi8(static_cast<char>(0xf0 - 0x80)));
+            const __m128i must_be_continuation = _mm_and_si128(_mm_or_si128(third, fourth), _mm_set1_epi8(static_cast<char>(0x80)));
+
+            errors = _mm_or_si128(errors, _mm_xor_si128(must_be_continuation, special));
+            before = current;
+        }
+        return !_mm_testz_si128(errors, errors);
+    }
+
+    __m128i chunks[4];
+};
+
+}
+
+const kernel_table sse42_kernels = make_kernel_table<sse42_block>();
+
+}
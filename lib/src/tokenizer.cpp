@@ -1,15 +1,136 @@
 #include <json-parser/tokenizer.h>
 
+#include <locale.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <limits>
+#include <string>
+#include <system_error>
+#include <thread>
+
 namespace json_parser {
 
+namespace {
+
+// Writes `value` as a JSON string, escaping whatever has to be.
+void serialize_string(std::ostream &os, std::string_view value)
+{
+    os << '"';
+    std::size_t plain = 0;
+    for (std::size_t i = 0; i < value.size(); ++i) {
+        const auto sym = static_cast<unsigned char>(value[i]);
+        if (sym >= 0x20 && sym != '"' && sym != '\\')
+            continue;
+
+        os.write(value.data() + plain, static_cast<std::streamsize>(i - plain));
+        plain = i + 1;
+        switch (sym) {
+            // clang-format off
+            break; case '"': os << "\\\"";
+            break; case '\\': os << "\\\\";
+            break; case '\b': os << "\\b";
+            break; case '\f': os << "\\f";
+            break; case '\n': os << "\\n";
+            break; case '\r': os << "\\r";
+            break; case '\t': os << "\\t";
+            break; default: {
+                static constexpr char hex[] = "0123456789abcdef";
+                const char escape[] = {'\\', 'u', '0', '0', hex[sym >> 4], hex[sym & 0x0f]};
+                os.write(escape, sizeof(escape));
+            }
+            // clang-format on
+        }
+    }
+    os.write(value.data() + plain, static_cast<std::streamsize>(value.size() - plain));
+    os << '"';
+}
+
+}
+
 void token_string::serialize(std::ostream& os) const
 {
-    os << '"' << m_value << '"';
+    serialize_string(os, value());
+}
+
+bool token_number::equals(const token &rhs) const noexcept
+{
+    const token_number* rhs_as_number = dynamic_cast<const token_number*>(&rhs);
+    if (rhs_as_number == nullptr)
+        return false;
+    if (!token::equals(rhs))
+        return false;
+
+    // Integers are compared exactly (2^53 + 1 is not 2^53), everything else as doubles.
+    if (m_kind != kind::Double && rhs_as_number->m_kind != kind::Double) {
+        if (fits_int64() != rhs_as_number->fits_int64())
+            return false;
+        return fits_int64() ? int64_value() == rhs_as_number->int64_value()
+                            : uint64_value() == rhs_as_number->uint64_value();
+    }
+    return value() == rhs_as_number->value();
+}
+
+bool token_number::fits_int64() const noexcept
+{
+    switch (m_kind) {
+    case kind::Int64:
+        return true;
+    case kind::Uint64:
+        return m_uint64 <= static_cast<std::uint64_t>(std::numeric_limits<std::int64_t>::max());
+    default:
+        // -2^63 is exact, 2^63 is the first one past the end.
+        return m_double >= -0x1p63 && m_double < 0x1p63 && m_double == static_cast<double>(static_cast<std::int64_t>(m_double));
+    }
+}
+
+bool token_number::fits_uint64() const noexcept
+{
+    switch (m_kind) {
+    case kind::Int64:
+        return m_int64 >= 0;
+    case kind::Uint64:
+        return true;
+    default:
+        return m_double >= 0 && m_double < 0x1p64 && m_double == static_cast<double>(static_cast<std::uint64_t>(m_double));
+    }
+}
+
+std::int64_t token_number::int64_value() const noexcept
+{
+    switch (m_kind) {
+    case kind::Int64:
+        return m_int64;
+    case kind::Uint64:
+        return static_cast<std::int64_t>(m_uint64);
+    default:
+        return static_cast<std::int64_t>(m_double);
+    }
+}
+
+std::uint64_t token_number::uint64_value() const noexcept
+{
+    switch (m_kind) {
+    case kind::Int64:
+        return static_cast<std::uint64_t>(m_int64);
+    case kind::Uint64:
+        return m_uint64;
+    default:
+        return static_cast<std::uint64_t>(m_double);
+    }
 }
 
 void token_number::serialize(std::ostream& os) const
 {
-    os << m_value;
+    switch (m_kind) {
+        break; case kind::Int64: os << m_int64;
+        break; case kind::Uint64: os << m_uint64;
+        break; case kind::Double: os << m_double;
+    }
 }
 
 void token_keyword::serialize(std::ostream& os) const
@@ -27,14 +148,451 @@ void token_punct::serialize(std::ostream& os) const
     os << m_value;
 }
 
+bool operator==(const token_value &lhs, const token_value &rhs) noexcept
+{
+    if (lhs.m_kind != rhs.m_kind)
+        return false;
+    switch (lhs.m_kind) {
+    case token_value::kind::Punct:
+        return lhs.m_punct == rhs.m_punct;
+    case token_value::kind::Keyword:
+        return lhs.m_keyword == rhs.m_keyword;
+    case token_value::kind::Number:
+        return lhs.m_number == rhs.m_number;
+    case token_value::kind::String:
+        break;
+    }
+    return lhs.string() == rhs.string();
+}
+
+void token_value::serialize(std::ostream& os) const
+{
+    switch (m_kind) {
+        break; case kind::Punct: os << m_punct;
+        break; case kind::Keyword: token_keyword{m_keyword}.serialize(os);
+        break; case kind::Number: m_number.serialize(os);
+        break; case kind::String: serialize_string(os, string());
+    }
+}
+
+mystd::unique_ptr<token> token_value::to_token() const
+{
+    switch (m_kind) {
+    case kind::Punct:
+        return make_token<token_punct>(m_punct);
+    case kind::Keyword:
+        return make_token<token_keyword>(m_keyword);
+    case kind::Number:
+        return make_token<token_number>(m_number);
+    case kind::String:
+        break;
+    }
+    return make_token<token_string>(std::string{string()});
+}
+
+std::size_t token_tape::skip(std::size_t i) const noexcept
+{
+    const tape_entry &entry = m_entries[i];
+    const bool opens = entry.kind == token_value::kind::Punct && (entry.punct == '[' || entry.punct == '{');
+    if (!opens)
+        return i + 1;
+    return entry.match == npos ? m_entries.size() : entry.match + 1;
+}
+
+void token_tape::append(const token_value &token, std::size_t offset, std::size_t length)
+{
+    tape_entry &entry = m_entries.emplace_back();
+    entry.kind = token.type();
+    entry.offset = offset;
+    entry.length = length;
+
+    switch (token.type()) {
+    case token_value::kind::Punct:
+        entry.punct = token.punct();
+        // Whether the brackets are of the same kind is up to the parser - here they are
+        // just paired up.
+        if (entry.punct == '[' || entry.punct == '{') {
+            m_open.push_back(m_entries.size() - 1);
+        } else if ((entry.punct == ']' || entry.punct == '}') && !m_open.empty()) {
+            entry.match = m_open.back();
+            m_entries[m_open.back()].match = m_entries.size() - 1;
+            m_open.pop_back();
+        }
+        break;
+    case token_value::kind::Keyword:
+        entry.keyword = token.keyword();
+        break;
+    case token_value::kind::Number:
+        entry.value = m_numbers.size();
+        m_numbers.push_back(token.number());
+        break;
+    case token_value::kind::String:
+        entry.value = m_strings.size();
+        entry.value_length = token.string().size();
+        m_strings += token.string();
+        break;
+    }
+}
+
+namespace {
+
+// Less than this much input per thread is not worth starting the thread.
+constexpr std::size_t min_parallel_chunk = 1 << 20;
+
+// Whether there is an odd number of backslashes right before `pos`. They are taken as escapes
+// outside of the strings too - there they are not valid anyway, and this way each chunk can
+// tell on its own without knowing whether it starts in a string.
+bool escaped_at(std::string_view input, std::size_t pos) noexcept
+{
+    std::size_t backslashes = 0;
+    while (backslashes < pos && input[pos - backslashes - 1] == '\\')
+        ++backslashes;
+    return backslashes % 2 == 1;
+}
+
+// Whether there is an odd number of unescaped quotes in [begin, end), i.e. whether being in a
+// string or not is flipped by the end of it.
+bool flips_string(std::string_view input, std::size_t begin, std::size_t end) noexcept
+{
+    bool flips = false;
+    std::size_t pos = begin + escaped_at(input, begin);
+    while (pos < end) {
+        pos += simd::scan_string(input.substr(pos, end - pos));
+        if (pos >= end)
+            break;
+        if (input[pos] == '\\') {
+            pos += 2;
+        } else {
+            flips = !flips;
+            ++pos;
+        }
+    }
+    return flips;
+}
+
+// The first punctuator outside a string at or after `pos` (or the end of the input) - a
+// token surely starts there.
+std::size_t next_token_boundary(std::string_view input, std::size_t pos, bool in_string) noexcept
+{
+    pos += escaped_at(input, pos);
+    while (pos < input.size()) {
+        if (in_string) {
+            pos += simd::scan_string(input.substr(pos));
+            if (pos >= input.size())
+                break;
+            in_string = input[pos] == '\\';
+            pos += in_string ? 2 : 1;
+            continue;
+        }
+
+        const char sym = input[pos];
+        if (detail::is(sym, detail::char_class::punct))
+            return pos;
+        in_string = sym == '"';
+        pos += sym == '\\' ? 2 : 1;
+    }
+    return input.size();
+}
+
+// Calls `fn(i)` for each of the `count` chunks, all of them at once. If a thread cannot be
+// started, its chunk is done on this one.
+template <typename Fn>
+void for_each_chunk(std::size_t count, Fn &&fn)
+{
+    std::vector<std::thread> workers;
+    workers.reserve(count);
+    for (std::size_t i = 1; i < count; ++i) {
+        try {
+            workers.emplace_back(fn, i);
+        } catch (const std::system_error &) {
+            fn(i);
+        }
+    }
+    fn(0);
+    for (std::thread &worker : workers)
+        worker.join();
+}
+
+}
+
+token_tape parallel_tape(std::string_view input, std::size_t threads)
+{
+    auto tokenize = [](std::string_view chunk) {
+        return view_tokenizer{view_input_reader{chunk}}.tape();
+    };
+
+    const std::size_t count = std::min(threads, input.size() / min_parallel_chunk);
+    if (count < 2)
+        return tokenize(input);
+
+    // Each chunk looks at its quotes first, so that it is known where the strings are.
+    std::vector<std::uint8_t> flips(count);
+    for_each_chunk(count, [&](std::size_t i) {
+        flips[i] = flips_string(input, i * input.size() / count, (i + 1) * input.size() / count);
+    });
+
+    std::vector<std::size_t> bounds(count + 1, input.size());
+    bounds[0] = 0;
+    bool in_string = false;
+    for (std::size_t i = 1; i < count; ++i) {
+        in_string ^= flips[i - 1] != 0;
+        bounds[i] = next_token_boundary(input, i * input.size() / count, in_string);
+    }
+
+    std::vector<token_tape> tapes(count);
+    std::vector<std::exception_ptr> errors(count);
+    for_each_chunk(count, [&](std::size_t i) {
+        try {
+            tapes[i] = tokenize(input.substr(bounds[i], bounds[i + 1] - bounds[i]));
+        } catch (...) {
+            errors[i] = std::current_exception();
+        }
+    });
+    // The chunks do not know where they are, so their errors would be off. The input is gone
+    // through again in order to find out what the error really is - and which tokens come
+    // before it.
+    const bool failed = std::ranges::any_of(errors, [](const std::exception_ptr &error) { return error != nullptr; })
+                        || std::ranges::any_of(tapes, [](const token_tape &tape) { return tape.failed(); });
+    if (failed)
+        return tokenize(input);
+
+    // Where each chunk goes in the whole tape.
+    std::vector<std::size_t> entries_at(count + 1), numbers_at(count + 1), strings_at(count + 1);
+    for (std::size_t i = 0; i < count; ++i) {
+        entries_at[i + 1] = entries_at[i] + tapes[i].m_entries.size();
+        numbers_at[i + 1] = numbers_at[i] + tapes[i].m_numbers.size();
+        strings_at[i + 1] = strings_at[i] + tapes[i].m_strings.size();
+    }
+
+    token_tape whole;
+    whole.m_entries.resize(entries_at[count]);
+    whole.m_numbers.resize(numbers_at[count], token_number{0.0});
+    whole.m_strings.resize(strings_at[count]);
+    whole.m_input_end = input.size();
+
+    // The closing brackets without a pair in their own chunk.
+    std::vector<std::vector<std::size_t>> unpaired(count);
+    for_each_chunk(count, [&](std::size_t i) {
+        const token_tape &tape = tapes[i];
+        for (std::size_t j = 0; j < tape.m_entries.size(); ++j) {
+            tape_entry entry = tape.m_entries[j];
+            entry.offset += bounds[i];
+            switch (entry.kind) {
+                // clang-format off
+                break; case token_value::kind::Punct:
+                    if (entry.punct != '[' && entry.punct != '{' && entry.punct != ']' && entry.punct != '}')
+                        break;
+                    if (entry.match != token_tape::npos)
+                        entry.match += entries_at[i];
+                    else if (entry.punct == ']' || entry.punct == '}')
+                        unpaired[i].push_back(entries_at[i] + j);
+                break; case token_value::kind::Number: entry.value += numbers_at[i];
+                break; case token_value::kind::String: entry.value += strings_at[i];
+                break; case token_value::kind::Keyword: break;
+                // clang-format on
+            }
+            whole.m_entries[entries_at[i] + j] = entry;
+        }
+        std::ranges::copy(tape.m_numbers, whole.m_numbers.begin() + static_cast<std::ptrdiff_t>(numbers_at[i]));
+        std::ranges::copy(tape.m_strings, whole.m_strings.begin() + static_cast<std::ptrdiff_t>(strings_at[i]));
+    });
+
+    // What is left is to pair up the brackets across the chunks - in order, as the tape would.
+    for (std::size_t i = 0; i < count; ++i) {
+        for (std::size_t close : unpaired[i]) {
+            if (whole.m_open.empty())
+                continue;
+            whole.m_entries[close].match = whole.m_open.back();
+            whole.m_entries[whole.m_open.back()].match = close;
+            whole.m_open.pop_back();
+        }
+        for (std::size_t open : tapes[i].m_open)
+            whole.m_open.push_back(entries_at[i] + open);
+    }
+    return whole;
+}
+
 [[nodiscard]] bool token_punct::is_valid(char value)
 {
-    static const char valid[] = "{}[]:,";
-    for (const char *pbegin = valid, *pend = valid + sizeof(valid);
-         pbegin < pend; ++pbegin)
-        if (*pbegin == value)
-            return true;
-    return false;
+    return detail::is(value, detail::char_class::punct);
+}
+
+namespace detail {
+
+namespace {
+
+constexpr bool is_digit(char sym) noexcept {
+    return sym >= '0' && sym <= '9';
+}
+
+// Some `std::from_chars` implementations give up on the numbers which are too close to zero
+// to be normal doubles, so those are left to `strtod` in the "C" locale.
+double strtod_c_locale(const char *first, const char *last) {
+    static const locale_t c_locale = ::newlocale(LC_ALL_MASK, "C", locale_t{});
+    char small[128];
+    std::string large;
+    const std::size_t size = static_cast<std::size_t>(last - first);
+    const char *terminated = small;
+    if (size < sizeof(small)) {
+        std::memcpy(small, first, size);
+        small[size] = '\0';
+    } else {
+        large.assign(first, last);
+        terminated = large.c_str();
+    }
+    return ::strtod_l(terminated, nullptr, c_locale);
+}
+
+// The powers of ten which a double holds exactly.
+constexpr double exact_powers_of_ten[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10,
+    1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+};
+
+}
+
+number_scan scan_number(std::span<const char> input) noexcept {
+    number_scan scan;
+    const std::size_t size = input.size();
+    std::size_t i = 0;
+
+    // The significant digits go to `mantissa` as long as they fit, the rest only move the
+    // decimal point. The value is `mantissa * 10^exponent`.
+    constexpr std::size_t max_digits = 19;
+    std::uint64_t mantissa = 0;
+    std::size_t digits = 0;
+    bool truncated = false;
+    std::int64_t exponent = 0;
+    auto take_digit = [&](char sym, bool after_point) {
+        if (mantissa == 0 && sym == '0') {
+            exponent -= after_point;
+        } else if (digits < max_digits) {
+            mantissa = mantissa * 10 + static_cast<std::uint64_t>(sym - '0');
+            ++digits;
+            exponent -= after_point;
+        } else {
+            truncated |= sym != '0';
+            exponent += !after_point;
+        }
+    };
+
+    const bool negative = i < size && input[i] == '-';
+    i += negative;
+
+    // The integer part - either a single zero or digits which do not start with one. Most
+    // numbers are just that, so it is read as an integer first.
+    if (!(i < size && is_digit(input[i]))) {
+        scan.length = i;
+        return scan;
+    }
+    const std::size_t integer_begin = i;
+    std::uint64_t integer = 0;
+    bool integer_overflow = false;
+    if (input[i] == '0') {
+        ++i;
+    } else {
+        for (; i < size && is_digit(input[i]); ++i) {
+            integer_overflow |= __builtin_mul_overflow(integer, 10, &integer);
+            integer_overflow |= __builtin_add_overflow(integer, static_cast<std::uint64_t>(input[i] - '0'), &integer);
+        }
+    }
+    scan.length = i;
+    scan.complete = true;
+
+    const bool has_fraction = i < size && input[i] == '.';
+    const bool has_exponent = i < size && (input[i] == 'e' || input[i] == 'E');
+    if (!has_fraction && !has_exponent && !integer_overflow && !(negative && integer == 0)) {
+        // -0 stays a double, so that it keeps its sign.
+        constexpr std::uint64_t max_int64 = static_cast<std::uint64_t>(std::numeric_limits<std::int64_t>::max());
+        if (!negative && integer > max_int64)
+            scan.number = token_number{integer};
+        else if (!negative)
+            scan.number = token_number{static_cast<std::int64_t>(integer)};
+        else if (integer <= max_int64 + 1)
+            scan.number = token_number{-static_cast<std::int64_t>(integer - 1) - 1};
+        else
+            scan.number = token_number{-static_cast<double>(integer)};
+        return scan;
+    }
+
+    // Up to 19 digits always fit, the longer ones go a digit at a time.
+    if (i - integer_begin <= max_digits && !integer_overflow) {
+        mantissa = integer;
+        digits = mantissa == 0 ? 0 : i - integer_begin;
+    } else {
+        for (std::size_t j = integer_begin; j < i; ++j)
+            take_digit(input[j], false);
+    }
+
+    if (has_fraction) {
+        ++i;
+        if (!(i < size && is_digit(input[i]))) {
+            scan.length = i;
+            scan.complete = false;
+            return scan;
+        }
+        for (; i < size && is_digit(input[i]); ++i)
+            take_digit(input[i], true);
+        scan.length = i;
+    }
+
+    if (i < size && (input[i] == 'e' || input[i] == 'E')) {
+        // Either right after the integer part or after the fraction.
+        ++i;
+        const bool negative_exponent = i < size && input[i] == '-';
+        if (i < size && (input[i] == '-' || input[i] == '+'))
+            ++i;
+        if (!(i < size && is_digit(input[i]))) {
+            scan.length = i;
+            scan.complete = false;
+            return scan;
+        }
+        // Saturates way past what a double can hold, so that it does not overflow.
+        std::int64_t written = 0;
+        for (; i < size && is_digit(input[i]); ++i)
+            written = std::min<std::int64_t>(written * 10 + (input[i] - '0'), 1'000'000);
+        exponent += negative_exponent ? -written : written;
+        scan.length = i;
+    }
+
+    // Both the mantissa and the power of ten are exact doubles, so a single multiplication or
+    // division is correctly rounded (Clinger's fast path). That covers most of the numbers
+    // one sees - the others are left to `std::from_chars`.
+    constexpr std::uint64_t max_exact_mantissa = std::uint64_t{1} << std::numeric_limits<double>::digits;
+    double value;
+    if (mantissa == 0) {
+        value = 0;
+    } else if (!truncated && mantissa <= max_exact_mantissa && exponent >= -22 && exponent <= 22) {
+        const double exact = static_cast<double>(mantissa);
+        value = exponent < 0 ? exact / exact_powers_of_ten[-exponent] : exact * exact_powers_of_ten[exponent];
+    } else {
+        const char *first = input.data() + negative;
+        const char *last = input.data() + scan.length;
+        if (std::from_chars(first, last, value).ec != std::errc{})
+            value = strtod_c_locale(first, last);
+    }
+    scan.number = token_number{negative ? -value : value};
+    return scan;
+}
+
+void append_utf8(std::string &out, char32_t code_point) {
+    if (code_point < 0x80) {
+        out += static_cast<char>(code_point);
+    } else if (code_point < 0x800) {
+        out += static_cast<char>(0xc0 | (code_point >> 6));
+        out += static_cast<char>(0x80 | (code_point & 0x3f));
+    } else if (code_point < 0x10000) {
+        out += static_cast<char>(0xe0 | (code_point >> 12));
+        out += static_cast<char>(0x80 | ((code_point >> 6) & 0x3f));
+        out += static_cast<char>(0x80 | (code_point & 0x3f));
+    } else {
+        out += static_cast<char>(0xf0 | (code_point >> 18));
+        out += static_cast<char>(0x80 | ((code_point >> 12) & 0x3f));
+        out += static_cast<char>(0x80 | ((code_point >> 6) & 0x3f));
+        out += static_cast<char>(0x80 | (code_point & 0x3f));
+    }
+}
+
 }
 
 }
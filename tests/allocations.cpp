@@ -0,0 +1,54 @@
+#include <cstdlib>
+#include <new>
+
+#include <json-parser-tests/allocations.h>
+
+// Every form of `operator new` and `operator delete` is replaced here, together, so that
+// whatever the compiler pairs up ends up in `malloc` and `free`. They are not inlined into the
+// callers, as there GCC would see `free` getting what `new` returned.
+
+static std::size_t g_allocations = 0;
+
+std::size_t allocation_count() { return g_allocations; }
+
+[[gnu::noinline]] static void *allocate(std::size_t size, std::size_t alignment) noexcept {
+    ++g_allocations;
+    if (alignment <= alignof(std::max_align_t))
+        return std::malloc(size ? size : 1);
+    // `aligned_alloc` wants the size to be a multiple of the alignment.
+    return std::aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment);
+}
+
+[[gnu::noinline]] static void *allocate_or_throw(std::size_t size, std::size_t alignment) {
+    if (void *ptr = allocate(size, alignment))
+        return ptr;
+    throw std::bad_alloc{};
+}
+
+[[gnu::noinline]] static void release(void *ptr) noexcept { std::free(ptr); }
+
+void *operator new(std::size_t size) { return allocate_or_throw(size, 0); }
+void *operator new[](std::size_t size) { return allocate_or_throw(size, 0); }
+void *operator new(std::size_t size, std::align_val_t al) { return allocate_or_throw(size, std::size_t(al)); }
+void *operator new[](std::size_t size, std::align_val_t al) { return allocate_or_throw(size, std::size_t(al)); }
+void *operator new(std::size_t size, const std::nothrow_t &) noexcept { return allocate(size, 0); }
+void *operator new[](std::size_t size, const std::nothrow_t &) noexcept { return allocate(size, 0); }
+void *operator new(std::size_t size, std::align_val_t al, const std::nothrow_t &) noexcept {
+    return allocate(size, std::size_t(al));
+}
+void *operator new[](std::size_t size, std::align_val_t al, const std::nothrow_t &) noexcept {
+    return allocate(size, std::size_t(al));
+}
+
+void operator delete(void *ptr) noexcept { release(ptr); }
+void operator delete[](void *ptr) noexcept { release(ptr); }
+void operator delete(void *ptr, std::size_t) noexcept { release(ptr); }
+void operator delete[](void *ptr, std::size_t) noexcept { release(ptr); }
+void operator delete(void *ptr, std::align_val_t) noexcept { release(ptr); }
+void operator delete[](void *ptr, std::align_val_t) noexcept { release(ptr); }
+void operator delete(void *ptr, std::size_t, std::align_val_t) noexcept { release(ptr); }
+void operator delete[](void *ptr, std::size_t, std::align_val_t) noexcept { release(ptr); }
+void operator delete(void *ptr, const std::nothrow_t &) noexcept { release(ptr); }
+void operator delete[](void *ptr, const std::nothrow_t &) noexcept { release(ptr); }
+void operator delete(void *ptr, std::align_val_t, const std::nothrow_t &) noexcept { release(ptr); }
+void operator delete[](void *ptr, std::align_val_t, const std::nothrow_t &) noexcept { release(ptr); }
@@ -0,0 +1,10 @@
+#ifndef FMI_JSON_PARSER_TESTS_ALLOCATIONS_INCLUDED
+#define FMI_JSON_PARSER_TESTS_ALLOCATIONS_INCLUDED
+
+#include <cstddef>
+
+/// How many times `operator new` (in any of its forms) has been called so far. It counts only in
+/// the tests which link `json-parser-tests-allocations` - that is where `operator new` is replaced.
+std::size_t allocation_count();
+
+#endif // FMI_JSON_PARSER_TESTS_ALLOCATIONS_INCLUDED
@@ -3,7 +3,9 @@
 
 #include <string>
 #include <fstream>
+#include <sstream>
 #include <utility>
+#include <vector>
 #include <filesystem>
 namespace fs = std::filesystem;
 
@@ -63,4 +65,52 @@ json_parser::json parse_from_string(const std::string &filename) {
     return json_parser::str_parser{json_parser::str_input_reader{contents}}();
 }
 
+json_parser::json parse_from_view(const std::string &filename) {
+    const std::string contents = slurp(filename);
+    return json_parser::view_parser{json_parser::view_input_reader{contents}}();
+}
+
+json_parser::json parse_via_tape(const std::string &filename) {
+    const std::string contents = slurp(filename);
+    return json_parser::view_parser{json_parser::view_input_reader{contents}}.parse_via_tape();
+}
+
+// Splits the contents into segments of `segment_size`, which the rope reader then walks.
+std::vector<std::span<const char>> split_into_segments(const std::string &contents, std::size_t segment_size) {
+    std::vector<std::span<const char>> segments;
+    for (std::size_t i = 0; i < contents.size(); i += segment_size)
+        segments.emplace_back(contents.data() + i, std::min(segment_size, contents.size() - i));
+    return segments;
+}
+
+json_parser::json parse_from_rope(const std::string &filename, std::size_t segment_size) {
+    const std::string contents = slurp(filename);
+    return json_parser::rope_parser{json_parser::rope_input_reader{split_into_segments(contents, segment_size)}}();
+}
+
+json_parser::json parse_from_mmap(const std::string &filename) {
+    return json_parser::mmap_parser{json_parser::mmap_input_reader{filename}}();
+}
+
+json_parser::json parse_from_buf(const std::string &filename,
+                                 std::size_t block_size = json_parser::buf_input_reader::default_block_size) {
+    return json_parser::buf_parser{json_parser::buf_input_reader{filename, block_size}}();
+}
+
+json_parser::json parse_from_stream(const std::string &filename,
+                                    std::size_t window_size = json_parser::stream_input_reader::default_window_size) {
+    std::istringstream is{slurp(filename)};
+    return json_parser::stream_parser{json_parser::stream_input_reader{is, window_size}}();
+}
+
+json_parser::json parse_from_compressed(const std::string &filename,
+                                        std::size_t window_size = json_parser::compressed_input_reader::default_window_size) {
+    return json_parser::compressed_parser{json_parser::compressed_input_reader{filename, window_size}}();
+}
+
+json_parser::json parse_from_async(const std::string &filename,
+                                   std::size_t window_size = json_parser::async_input_reader::default_window_size) {
+    return json_parser::async_parser{json_parser::async_input_reader{filename, window_size}}();
+}
+
 #endif // FMI_JSON_PARSER_TESTS_COMMON_INCLUDED
@@ -0,0 +1,164 @@
+#include <unistd.h>
+
+#include <sstream>
+
+#include <gtest/gtest.h>
+
+#include <json-parser/input_reader.h>
+
+#include <json-parser-tests/common.h>
+
+using namespace json_parser;
+
+// Reads the whole input using only `window()` and `advance()`.
+template <typename InputReader>
+static std::string drain_by_windows(InputReader &reader, std::size_t n) {
+    std::string contents;
+    for (auto chunk = reader.window(n); !chunk.empty(); chunk = reader.window(n)) {
+        EXPECT_GE(chunk.size(), std::min<std::size_t>(n, 1));
+        // Take only a part of the window every now and then, so that it has to be refilled
+        // from the middle.
+        const std::size_t count = chunk.size() > 3 ? chunk.size() - 3 : chunk.size();
+        contents.append(chunk.data(), count);
+        reader.advance(count);
+    }
+    EXPECT_TRUE(reader.eof());
+    return contents;
+}
+
+TEST(InputReaderTests, WindowsCoverTheWholeInput) {
+    const std::string filename = TESTS_DIR_PREFIX"samples/jokes.json";
+    const std::string expected = slurp(filename);
+
+    for (std::size_t n : {std::size_t{1}, std::size_t{16}, std::size_t{4096}}) {
+        ifs_input_reader ifs{filename};
+        EXPECT_EQ(drain_by_windows(ifs, n), expected);
+
+        str_input_reader str{expected};
+        EXPECT_EQ(drain_by_windows(str, n), expected);
+
+        view_input_reader view{expected};
+        EXPECT_EQ(drain_by_windows(view, n), expected);
+
+        rope_input_reader rope{split_into_segments(expected, 5)};
+        EXPECT_EQ(drain_by_windows(rope, n), expected);
+
+        mmap_input_reader mmap{filename};
+        EXPECT_EQ(drain_by_windows(mmap, n), expected);
+
+        buf_input_reader buf{filename, 7};
+        EXPECT_EQ(drain_by_windows(buf, n), expected);
+
+        async_input_reader async{filename, 7};
+        EXPECT_EQ(drain_by_windows(async, n), expected);
+
+        std::istringstream is{expected};
+        stream_input_reader stream{is, 7};
+        EXPECT_EQ(drain_by_windows(stream, n), expected);
+    }
+}
+
+TEST(InputReaderTests, WindowMixedWithGet) {
+    str_input_reader reader{"abcdef"};
+    EXPECT_EQ(reader.get(), 'a');
+    auto chunk = reader.window(2);
+    ASSERT_GE(chunk.size(), 2);
+    EXPECT_EQ(chunk[0], 'b');
+    reader.advance(2);
+    EXPECT_EQ(reader.tell(), 3);
+    EXPECT_EQ(reader.peek(), 'd');
+}
+
+TEST(InputReaderTests, BufWindowOverPipe) {
+    const std::string contents = slurp(TESTS_DIR_PREFIX"samples/simple.json");
+    int fds[2];
+    ASSERT_EQ(::pipe(fds), 0);
+    ASSERT_EQ(::write(fds[1], contents.data(), contents.size()), (ssize_t) contents.size());
+    ::close(fds[1]);
+
+    buf_input_reader reader{fds[0], 5};
+    EXPECT_EQ(drain_by_windows(reader, 4), contents);
+    ::close(fds[0]);
+
+    // The stream is consumed, so there is no going back.
+    reader.seek(0);
+    EXPECT_THROW((void) reader.peek(), input_reader_exception);
+}
+
+TEST(InputReaderTests, StreamWindowStaysBounded) {
+    const std::string contents = slurp(TESTS_DIR_PREFIX"samples/jokes.json");
+    std::istringstream is{contents};
+    stream_input_reader reader{is, 32};
+
+    // No matter how much is asked for, only a window's worth of the input is held.
+    EXPECT_LE(reader.window(contents.size()).size(), 32);
+    EXPECT_EQ(drain_by_windows(reader, 1000), contents);
+
+    reader.seek(0);
+    EXPECT_THROW((void) reader.peek(), input_reader_exception);
+}
+
+TEST(InputReaderTests, CompressedMatchesPlain) {
+    const std::string expected = slurp(TESTS_DIR_PREFIX"samples/jokes.json");
+
+    // The sample consists of two gzip members which have to be read one after another.
+    compressed_input_reader gz{TESTS_DIR_PREFIX"samples/jokes.json.gz", 64};
+    EXPECT_EQ(gz.compression(), compressed_input_reader::codec::gzip);
+    EXPECT_EQ(drain_by_windows(gz, 16), expected);
+
+    compressed_input_reader plain{TESTS_DIR_PREFIX"samples/jokes.json"};
+    EXPECT_EQ(plain.compression(), compressed_input_reader::codec::none);
+    EXPECT_EQ(drain_by_windows(plain, 4096), expected);
+}
+
+TEST(InputReaderTests, CompressedTruncated) {
+    const std::string compressed = slurp(TESTS_DIR_PREFIX"samples/nested.json.gz");
+    const std::string path = (fs::temp_directory_path() / "fmi-json-parser-truncated.json.gz").string();
+    std::ofstream{path, std::ios::binary | std::ios::trunc} << compressed.substr(0, compressed.size() / 2);
+
+    compressed_input_reader reader{path};
+    fs::remove(path);
+    EXPECT_THROW(drain_by_windows(reader, 4096), input_reader_exception);
+}
+
+TEST(InputReaderTests, CompressedMissingFile) {
+    EXPECT_THROW((void) compressed_input_reader{TESTS_DIR_PREFIX"samples/this-file-does-not-exist.json.gz"}, input_reader_exception);
+}
+
+TEST(InputReaderTests, AsyncSeekBackwards) {
+    const std::string filename = TESTS_DIR_PREFIX"samples/jokes.json";
+    const std::string expected = slurp(filename);
+
+    async_input_reader reader{filename, 16};
+    EXPECT_EQ(drain_by_windows(reader, 16), expected);
+
+    // The file can be read again, so going back only restarts the prefetching.
+    reader.seek(1);
+    EXPECT_EQ(reader.get(), expected[1]);
+
+    async_input_reader copy{reader};
+    EXPECT_EQ(drain_by_windows(copy, 4096), expected.substr(2));
+}
+
+TEST(InputReaderTests, RopeSeekAcrossSegments) {
+    const std::string first = "ab", second = "", third = "cdef";
+    rope_input_reader reader{{first, second, third}};
+    EXPECT_EQ(reader.size(), 6);
+    EXPECT_EQ(reader.segments(), 2);
+
+    reader.seek(3);
+    EXPECT_EQ(reader.get(), 'd');
+    reader.seek(1);
+    EXPECT_EQ(reader.get(), 'b');
+    EXPECT_EQ(reader.get(), 'c');
+    EXPECT_EQ(reader.tell(), 3);
+
+    // A window spanning both segments is stitched together.
+    reader.seek(0);
+    auto chunk = reader.window(4);
+    EXPECT_EQ(std::string(chunk.data(), chunk.size()), "abcd");
+
+    reader.advance(6);
+    EXPECT_TRUE(reader.eof());
+    EXPECT_THROW((void) reader.peek(), input_reader_exception);
+}
@@ -59,6 +59,18 @@ TEST(JsonTests, JsonFollowPath) {
     const json::value &actual_birthday = *parsed.follow(path_to_the_birthday_of_JohnDoe);
     EXPECT_EQ(*expected_birthday, actual_birthday);
 
+    // Integral doubles do just as well as integers.
+    json::path path_through_double;
+    path_through_double.emplace_back(json::make_node<json::string>("offices"));
+    path_through_double.emplace_back(json::make_node<json::number>(1.0));
+    path_through_double.emplace_back(json::make_node<json::string>("address"));
+    EXPECT_EQ(*expected_address, *parsed.follow(path_through_double));
+
+    json::path path_through_fraction;
+    path_through_fraction.emplace_back(json::make_node<json::string>("offices"));
+    path_through_fraction.emplace_back(json::make_node<json::number>(1.5));
+    EXPECT_THROW((void) parsed.follow(path_through_fraction), json_exception);
+
     json::path empty_path;
     EXPECT_NO_THROW((void) parsed.follow(empty_path));
 
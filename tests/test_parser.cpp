@@ -1,8 +1,11 @@
+#include <unistd.h>
+
 #include <gtest/gtest.h>
 
 #include <json-parser/parser.h>
 
 #include <json-parser-tests/common.h>
+#include <json-parser-tests/allocations.h>
 
 using namespace json_parser;
 
@@ -133,6 +136,42 @@ TEST(JsonTests, ParseSingleNumber) {
     EXPECT_EQ(num, 1);
 }
 
+TEST(JsonTests, ParseIntegersExactly) {
+    const json parsed = json_parser::str_parser{json_parser::str_input_reader{
+        "[9007199254740993, -9223372036854775808, 18446744073709551615, 18446744073709551616, 2.5]"}}();
+    const json::array &array = dynamic_cast<const json::array &>(parsed.root_unsafe());
+
+    // Past 2^53 a double would have lost the last digit.
+    const json::number &id = dynamic_cast<const json::number &>(array[0]);
+    EXPECT_EQ(id.representation(), token_number::kind::Int64);
+    EXPECT_EQ(id.int64_value(), 9007199254740993);
+    EXPECT_NE(id, json::number{std::int64_t{9007199254740992}});
+
+    const json::number &min = dynamic_cast<const json::number &>(array[1]);
+    ASSERT_TRUE(min.fits_int64());
+    EXPECT_EQ(min.int64_value(), std::numeric_limits<std::int64_t>::min());
+    EXPECT_FALSE(min.fits_uint64());
+
+    const json::number &max = dynamic_cast<const json::number &>(array[2]);
+    EXPECT_EQ(max.representation(), token_number::kind::Uint64);
+    EXPECT_EQ(max.uint64_value(), std::numeric_limits<std::uint64_t>::max());
+    EXPECT_FALSE(max.fits_int64());
+
+    // Too large for any integer, so it is a double after all.
+    const json::number &huge = dynamic_cast<const json::number &>(array[3]);
+    EXPECT_EQ(huge.representation(), token_number::kind::Double);
+    EXPECT_EQ((double) huge, 18446744073709551616.0);
+
+    const json::number &fraction = dynamic_cast<const json::number &>(array[4]);
+    EXPECT_EQ(fraction.representation(), token_number::kind::Double);
+    EXPECT_FALSE(fraction.fits_int64());
+
+    std::ostringstream osstr;
+    parsed.dump(osstr);
+    EXPECT_NE(osstr.str().find("9007199254740993"), std::string::npos);
+    EXPECT_NE(osstr.str().find("18446744073709551615"), std::string::npos);
+}
+
 TEST(JsonTests, ParseEmptyObjectAndArray) {
     auto parsed_array = json_parser::str_parser{json_parser::str_input_reader{"[]"}}();
     EXPECT_TRUE(parsed_array.compound());
@@ -145,12 +184,553 @@ TEST(JsonTests, ParseEmptyObjectAndArray) {
     EXPECT_TRUE(object.empty());
 }
 
+///
+/// view_input_reader
+///
+
+TEST(JsonTests, ParseNestedViewInputReader) {
+    const json parsed = parse_from_view(TESTS_DIR_PREFIX"samples/nested.json");
+    const json::object &quiz = dynamic_cast<const json::object &>(parsed["quiz"]);
+    const json::object &maths = dynamic_cast<const json::object &>(quiz["maths"]);
+    const json::object &q2 = dynamic_cast<const json::object &>(maths["q2"]);
+    const json::array &q2_options = dynamic_cast<const json::array &>(q2["options"]);
+    const json::string &q2_option_2 = dynamic_cast<const json::string &>(q2_options[2]);
+
+    EXPECT_EQ(std::string { q2_option_2 }, "3");
+}
+
+TEST(JsonTests, ParseSpanViewInputReader) {
+    const char buffer[] = { '[', '1', ',', ' ', '"', 'a', '"', ']' };
+    const view_input_reader reader{std::span<const char>{buffer}};
+
+    // Copies of the reader refer to the very same buffer.
+    const view_input_reader copy{reader};
+    EXPECT_EQ(copy.view().data(), buffer);
+    EXPECT_EQ(copy.view().size(), sizeof(buffer));
+
+    const json parsed = view_parser{reader}();
+    const json::array &array = dynamic_cast<const json::array &>(parsed.root_unsafe());
+    EXPECT_EQ(array.size(), 2);
+    EXPECT_EQ(dynamic_cast<const json::number &>(array[0]), 1);
+    EXPECT_EQ(dynamic_cast<const json::string &>(array[1]), "a");
+}
+
+///
+/// mmap_input_reader
+///
+
+TEST(JsonTests, ParseJokesMmapInputReader) {
+    const json parsed = parse_from_mmap(TESTS_DIR_PREFIX"samples/jokes.json");
+
+    const json::number &amount_val = dynamic_cast<const json::number &>(parsed["amount"]);
+    EXPECT_EQ(amount_val, 6.);
+
+    const json::array &jokes_val = dynamic_cast<const json::array &>(parsed["jokes"]);
+    const json::object &joke_no4 = dynamic_cast<const json::object &>(jokes_val[4]);
+    const json::string &joke_no4_setup = dynamic_cast<const json::string &>(joke_no4["setup"]);
+    EXPECT_EQ(std::string{joke_no4_setup}, "Why did the koala get rejected?");
+}
+
+TEST(JsonTests, ParseEmptyMmapInputReader) {
+    const json parsed = parse_from_mmap(TESTS_DIR_PREFIX"samples/empty.json");
+    EXPECT_TRUE(parsed.empty());
+}
+
+TEST(JsonTests, ParseMissingFileMmapInputReader) {
+    EXPECT_THROW((void) mmap_input_reader{TESTS_DIR_PREFIX"samples/this-file-does-not-exist.json"}, input_reader_exception);
+}
+
+///
+/// buf_input_reader
+///
+
+TEST(JsonTests, ParseNestedBufInputReader) {
+    // A tiny block size makes sure that tokens get split between refills.
+    for (std::size_t block_size : {std::size_t{1}, std::size_t{7}, buf_input_reader::default_block_size}) {
+        const json parsed = parse_from_buf(TESTS_DIR_PREFIX"samples/nested.json", block_size);
+        const json::object &quiz = dynamic_cast<const json::object &>(parsed["quiz"]);
+        const json::object &maths = dynamic_cast<const json::object &>(quiz["maths"]);
+        const json::object &q2 = dynamic_cast<const json::object &>(maths["q2"]);
+        const json::string &q2_question = dynamic_cast<const json::string &>(q2["question"]);
+        EXPECT_EQ(std::string{ q2_question }, "12 - 8 = ?");
+    }
+}
+
+TEST(JsonTests, ParsePipeBufInputReader) {
+    const std::string contents = slurp(TESTS_DIR_PREFIX"samples/simple.json");
+    int fds[2];
+    ASSERT_EQ(::pipe(fds), 0);
+    // The sample is way smaller than the pipe capacity, so it can be written upfront.
+    ASSERT_EQ(::write(fds[1], contents.data(), contents.size()), (ssize_t) contents.size());
+    ::close(fds[1]);
+
+    const json parsed = buf_parser{buf_input_reader{fds[0], 16}}();
+    ::close(fds[0]);
+
+    const json::string &fruit_val = dynamic_cast<const json::string &>(parsed["fruit"]);
+    EXPECT_EQ(fruit_val, "Apple");
+    const json::string &color_val = dynamic_cast<const json::string &>(parsed["color"]);
+    EXPECT_EQ(color_val, "Red");
+}
+
+///
+/// stream_input_reader
+///
+
+TEST(JsonTests, ParseNestedStreamInputReader) {
+    for (std::size_t window_size : {std::size_t{1}, std::size_t{7}, stream_input_reader::default_window_size}) {
+        const json parsed = parse_from_stream(TESTS_DIR_PREFIX"samples/nested.json", window_size);
+        const json::object &quiz = dynamic_cast<const json::object &>(parsed["quiz"]);
+        const json::object &maths = dynamic_cast<const json::object &>(quiz["maths"]);
+        const json::object &q2 = dynamic_cast<const json::object &>(maths["q2"]);
+        const json::string &q2_question = dynamic_cast<const json::string &>(q2["question"]);
+        EXPECT_EQ(std::string{ q2_question }, "12 - 8 = ?");
+    }
+}
+
+///
+/// compressed_input_reader
+///
+
+TEST(JsonTests, ParseNestedCompressedInputReader) {
+    for (std::size_t window_size : {std::size_t{7}, compressed_input_reader::default_window_size}) {
+        const json parsed = parse_from_compressed(TESTS_DIR_PREFIX"samples/nested.json.gz", window_size);
+        const json::object &quiz = dynamic_cast<const json::object &>(parsed["quiz"]);
+        const json::object &maths = dynamic_cast<const json::object &>(quiz["maths"]);
+        const json::object &q2 = dynamic_cast<const json::object &>(maths["q2"]);
+        const json::string &q2_question = dynamic_cast<const json::string &>(q2["question"]);
+        EXPECT_EQ(std::string{ q2_question }, "12 - 8 = ?");
+    }
+}
+
+TEST(JsonTests, ParseUncompressedCompressedInputReader) {
+    // Files which are not compressed are read as they are.
+    const json parsed = parse_from_compressed(TESTS_DIR_PREFIX"samples/simple.json");
+    const json::string &fruit_val = dynamic_cast<const json::string &>(parsed["fruit"]);
+    EXPECT_EQ(fruit_val, "Apple");
+}
+
+///
+/// async_input_reader
+///
+
+TEST(JsonTests, ParseNestedAsyncInputReader) {
+    for (std::size_t window_size : {std::size_t{7}, async_input_reader::default_window_size}) {
+        const json parsed = parse_from_async(TESTS_DIR_PREFIX"samples/nested.json", window_size);
+        const json::object &quiz = dynamic_cast<const json::object &>(parsed["quiz"]);
+        const json::object &maths = dynamic_cast<const json::object &>(quiz["maths"]);
+        const json::object &q2 = dynamic_cast<const json::object &>(maths["q2"]);
+        const json::string &q2_question = dynamic_cast<const json::string &>(q2["question"]);
+        EXPECT_EQ(std::string{ q2_question }, "12 - 8 = ?");
+    }
+}
+
+TEST(JsonTests, ParseMissingFileAsyncInputReader) {
+    EXPECT_THROW((void) async_input_reader{TESTS_DIR_PREFIX"samples/this-file-does-not-exist.json"}, input_reader_exception);
+}
+
+///
+/// rope_input_reader
+///
+
+TEST(JsonTests, ParseNestedRopeInputReader) {
+    // Tiny segments make sure that tokens get split between them.
+    for (std::size_t segment_size : {std::size_t{1}, std::size_t{7}, std::size_t{4096}}) {
+        const json parsed = parse_from_rope(TESTS_DIR_PREFIX"samples/nested.json", segment_size);
+        const json::object &quiz = dynamic_cast<const json::object &>(parsed["quiz"]);
+        const json::object &maths = dynamic_cast<const json::object &>(quiz["maths"]);
+        const json::object &q2 = dynamic_cast<const json::object &>(maths["q2"]);
+        const json::string &q2_question = dynamic_cast<const json::string &>(q2["question"]);
+        EXPECT_EQ(std::string{ q2_question }, "12 - 8 = ?");
+    }
+}
+
+TEST(JsonTests, ParseBadRopeInputReaderReportsSameLocation) {
+    const std::string filename = TESTS_DIR_PREFIX"samples/bad_unexpected_symbol.json";
+    std::string expected;
+    try {
+        (void) parse_from_view(filename);
+    } catch (const std::exception &e) {
+        expected = e.what();
+    }
+    ASSERT_FALSE(expected.empty());
+
+    for (std::size_t segment_size : {std::size_t{1}, std::size_t{3}}) {
+        try {
+            (void) parse_from_rope(filename, segment_size);
+            FAIL() << "Expected the rope reader to fail as well.";
+        } catch (const std::exception &e) {
+            EXPECT_EQ(std::string{e.what()}, expected);
+        }
+    }
+}
+
+///
+/// token_tape
+///
+
+TEST(JsonTests, ParseViaTapeMatchesStreaming) {
+    for (const char *sample : {"simple", "array", "array_of_objects", "jokes", "nested", "organisation", "string-only", "empty"}) {
+        const std::string filename = std::string{TESTS_DIR_PREFIX"samples/"} + sample + ".json";
+        std::ostringstream expected, actual;
+        parse_from_view(filename).dump(expected);
+        parse_via_tape(filename).dump(actual);
+        EXPECT_EQ(actual.str(), expected.str()) << sample;
+    }
+}
+
+TEST(JsonTests, ParseBadViaTapeReportsTheSame) {
+    const auto error_of = [](const std::string &input, auto parse) -> std::string {
+        try {
+            (void) parse(view_parser{view_input_reader{input}});
+        } catch (const parser_exception &e) {
+            return e.what();
+        }
+        return "no error";
+    };
+    const auto streaming = [](view_parser &&parser) { return std::move(parser).parse(); };
+    const auto via_tape = [](view_parser &&parser) { return std::move(parser).parse_via_tape(); };
+    const auto via_parallel_tape = [](view_parser &&parser) { return std::move(parser).parse_via_parallel_tape(2); };
+
+    std::vector<std::string> inputs;
+    for (const char *sample : {"bad_extra_comma_array", "bad_extra_comma_object", "bad_missing_column",
+                               "bad_missing_comma_array", "bad_missing_comma_object", "bad_unclosed_array",
+                               "bad_unclosed_object", "bad_unclosed_string", "bad_unexpected_symbol"})
+        inputs.push_back(slurp(std::string{TESTS_DIR_PREFIX"samples/"} + sample + ".json"));
+    // The locations are worked out from the whitespace before the error as well, and the
+    // tokens may run out anywhere.
+    for (const char *input : {"\n\n   [1, @]", "\t{\"a\": tru}", "  [1, 2.5e", "[1,2", "[1,2 ", "[1,]", "{\"a\":",
+                              "{\"a\":1", "{\"a\" 1}", "{\"a\"}", "[[]", "[1 2]", "{[1, 2]: 3}", "{1: 2}"})
+        inputs.push_back(input);
+
+    for (const std::string &input : inputs) {
+        const std::string expected = error_of(input, streaming);
+        ASSERT_NE(expected, "no error") << input;
+        EXPECT_EQ(error_of(input, via_tape), expected) << input;
+        EXPECT_EQ(error_of(input, via_parallel_tape), expected) << input;
+    }
+    // With more than one error, the first one in the input is reported - even if the tokens
+    // are fine up to it and it is the tokenizer who would have found the later one.
+    for (const char *input : {"]ull,", "{\"a\" 1, \"b\": tru}", "[1 2, @]", "[1, 2] @", "{\"a\": [1, 2, ]] tru"}) {
+        const std::string expected = error_of(input, streaming);
+        ASSERT_NE(expected, "no error") << input;
+        EXPECT_EQ(error_of(input, via_tape), expected) << input;
+        EXPECT_EQ(error_of(input, via_parallel_tape), expected) << input;
+    }
+    EXPECT_EQ(error_of("\n\n   [1, @]", via_tape), "Line: 2, Column: 8 (Detail-specific: 10): Unexpected symbol '@' found.");
+    EXPECT_EQ(error_of("[1,2", via_tape), "Expected more tokens during parsing.");
+}
+
+TEST(JsonTests, ParseViaParallelTapeMatchesStreaming) {
+    // Big enough to be split up between the threads.
+    std::string input = "[";
+    for (std::size_t i = 0; input.size() < (3 << 20); ++i) {
+        if (i > 0)
+            input += ", ";
+        input += R"({ "id" : )" + std::to_string(i) + R"(, "name" : "record \"[)" + std::to_string(i) + R"(]\"", "tags" : [ true, null, 1.5 ] })";
+    }
+    input += "]";
+
+    std::ostringstream expected, actual;
+    view_parser{view_input_reader{input}}().dump(expected);
+    view_parser{view_input_reader{input}}.parse_via_parallel_tape(3).dump(actual);
+    EXPECT_EQ(actual.str(), expected.str());
+
+    input.back() = ',';
+    try {
+        (void) view_parser{view_input_reader{input}}.parse_via_parallel_tape(3);
+        FAIL() << "The array is not closed";
+    } catch (const parser_exception &) {
+    }
+
+    // A missing comma in the first chunk comes before a bad keyword in the last one.
+    input.back() = ']';
+    input.replace(input.find(", \"name\""), 1, " ");
+    input.replace(input.rfind("true"), 4, "tru!");
+    std::string expected_error;
+    try {
+        (void) view_parser{view_input_reader{input}}();
+    } catch (const parser_exception &e) {
+        expected_error = e.what();
+    }
+    ASSERT_NE(expected_error.find("token_punct"), std::string::npos) << expected_error;
+    try {
+        (void) view_parser{view_input_reader{input}}.parse_via_parallel_tape(3);
+        FAIL() << "The input is not valid";
+    } catch (const parser_exception &e) {
+        EXPECT_EQ(std::string{e.what()}, expected_error);
+    }
+}
+
+///
+/// try_parse
+///
+
+TEST(JsonTests, TryParseMatchesParse) {
+    for (const char *sample : {"simple", "array", "array_of_objects", "jokes", "nested", "organisation", "string-only", "empty"}) {
+        const std::string filename = std::string{TESTS_DIR_PREFIX"samples/"} + sample + ".json";
+        const std::string contents = slurp(filename);
+        const parse_result<json> result = view_parser{view_input_reader{contents}}.try_parse();
+        ASSERT_TRUE(result.has_value()) << sample << ": " << result.error().message;
+
+        std::ostringstream expected, actual;
+        parse_from_view(filename).dump(expected);
+        result->dump(actual);
+        EXPECT_EQ(actual.str(), expected.str()) << sample;
+    }
+}
+
+TEST(JsonTests, TryParseReportsTheSameErrors) {
+    const std::vector<std::pair<const char *, parse_errc>> samples = {
+        {"bad_extra_comma_array", parse_errc::syntax},
+        {"bad_extra_comma_object", parse_errc::syntax},
+        {"bad_missing_column", parse_errc::syntax},
+        {"bad_missing_comma_array", parse_errc::syntax},
+        {"bad_missing_comma_object", parse_errc::syntax},
+        {"bad_unclosed_array", parse_errc::unexpected_end},
+        {"bad_unclosed_object", parse_errc::syntax},
+        {"bad_unclosed_string", parse_errc::unexpected_symbol},
+        {"bad_unexpected_symbol", parse_errc::unexpected_symbol},
+    };
+    for (const auto &[sample, code] : samples) {
+        const std::string filename = std::string{TESTS_DIR_PREFIX"samples/"} + sample + ".json";
+        std::string expected;
+        try {
+            (void) parse_from_view(filename);
+        } catch (const parser_exception &e) {
+            expected = e.what();
+        }
+        ASSERT_FALSE(expected.empty()) << sample;
+
+        const std::string contents = slurp(filename);
+        const parse_result<json> result = view_parser{view_input_reader{contents}}.try_parse();
+        ASSERT_FALSE(result.has_value()) << sample;
+        EXPECT_EQ(result.error().message, expected) << sample;
+        EXPECT_EQ(result.error().code, code) << sample;
+    }
+
+    // The end of the input in the middle of a token is not left to the input reader.
+    for (const std::string input : {R"(["abc\)", R"(["\u12)", R"(["\ud800\)", "[1, 2.5e"}) {
+        const parse_result<json> result = str_parser{str_input_reader{input}}.try_parse();
+        ASSERT_FALSE(result.has_value()) << input;
+        EXPECT_EQ(result.error().code, parse_errc::unexpected_end) << input;
+        EXPECT_EQ(result.error().where.detail_pos(), input.size()) << input;
+    }
+}
+
+TEST(JsonTests, ParseDeeplyNested) {
+    // Arrays and objects in turns - `depth` of them in one another, with a 0 in the middle.
+    auto nested = [](std::size_t depth) {
+        std::string input;
+        for (std::size_t i = 0; i < depth; ++i)
+            input += i % 2 ? R"({"k": )" : "[1, ";
+        input += "0";
+        for (std::size_t i = depth; i-- > 0;)
+            input += i % 2 ? "}" : "]";
+        return input;
+    };
+
+    const std::string deepest = nested(default_max_depth);
+    const parse_result<json> parsed = view_parser{view_input_reader{deepest}}.try_parse();
+    ASSERT_TRUE(parsed.has_value()) << parsed.error().message;
+    const json::value *inner = parsed->root();
+    for (std::size_t i = 0; i < default_max_depth; ++i) {
+        if (i % 2) {
+            inner = &dynamic_cast<const json::object &>(*inner)["k"];
+        } else {
+            inner = &dynamic_cast<const json::array &>(*inner)[1];
+        }
+    }
+    EXPECT_EQ(dynamic_cast<const json::number &>(*inner).int64_value(), 0);
+
+    // Far too deep for the call stack, had the parser been going down it.
+    for (std::size_t depth : {default_max_depth + 1, std::size_t{100000}}) {
+        const std::string input = nested(depth);
+        const parse_result<json> result = view_parser{view_input_reader{input}}.try_parse();
+        ASSERT_FALSE(result.has_value()) << depth;
+        EXPECT_EQ(result.error().code, parse_errc::too_deep) << depth;
+
+        std::string expected;
+        try {
+            (void) view_parser{view_input_reader{input}}();
+        } catch (const parser_exception &e) {
+            expected = e.what();
+        }
+        EXPECT_EQ(expected, result.error().message) << depth;
+        try {
+            (void) view_parser{view_input_reader{input}}.parse_via_tape();
+            ADD_FAILURE() << "Expected the tape to fail as well: " << depth;
+        } catch (const parser_exception &e) {
+            EXPECT_EQ(std::string{e.what()}, expected) << depth;
+        }
+    }
+
+    // The limit is up to whoever parses.
+    EXPECT_TRUE(view_parser(view_input_reader{nested(3)}, 3).try_parse().has_value());
+    EXPECT_FALSE(view_parser(view_input_reader{nested(4)}, 3).try_parse().has_value());
+}
+
+///
+/// json_handler
+///
+
+namespace {
+
+// Writes down what it is told, one event after another.
+struct event_log {
+    std::vector<std::string> events;
+
+    void on_null() { events.push_back("null"); }
+    void on_bool(bool value) { events.push_back(value ? "true" : "false"); }
+    void on_number(const token_number &value) { events.push_back("number " + std::to_string(value.value())); }
+    void on_string(std::string_view value) { events.push_back("string " + std::string{value}); }
+    void on_key(std::string_view key) { events.push_back("key " + std::string{key}); }
+    void on_array_begin() { events.push_back("["); }
+    void on_array_end() { events.push_back("]"); }
+    void on_object_begin() { events.push_back("{"); }
+    void on_object_end() { events.push_back("}"); }
+};
+
+}
+
+TEST(JsonTests, ParseIntoHandler) {
+    const std::string input = R"({"a": [1, [], {}, "x\ty"], "b": {"c": null, "d": true}, "e": false})";
+    event_log log;
+    view_parser{view_input_reader{input}}.parse(log);
+    EXPECT_EQ(log.events, (std::vector<std::string>{
+        "{",
+            "key a", "[", "number 1.000000", "[", "]", "{", "}", "string x\ty", "]",
+            "key b", "{", "key c", "null", "key d", "true", "}",
+            "key e", "false",
+        "}",
+    }));
+
+    event_log scalar;
+    str_parser{str_input_reader{std::string{R"("just a string")"}}}.parse(scalar);
+    EXPECT_EQ(scalar.events, std::vector<std::string>{"string just a string"});
+
+    event_log nothing;
+    str_parser{str_input_reader{std::string{"  "}}}.parse(nothing);
+    EXPECT_TRUE(nothing.events.empty());
+}
+
+TEST(JsonTests, ParseIntoHandlerReportsTheSameErrors) {
+    for (const char *sample : {"bad_extra_comma_array", "bad_extra_comma_object", "bad_missing_column",
+                               "bad_missing_comma_array", "bad_missing_comma_object", "bad_unclosed_array",
+                               "bad_unclosed_object", "bad_unclosed_string", "bad_unexpected_symbol"}) {
+        const std::string filename = std::string{TESTS_DIR_PREFIX"samples/"} + sample + ".json";
+        std::string expected;
+        try {
+            (void) parse_from_view(filename);
+        } catch (const parser_exception &e) {
+            expected = e.what();
+        }
+        ASSERT_FALSE(expected.empty()) << sample;
+
+        const std::string contents = slurp(filename);
+        event_log log;
+        const parse_result<void> result = view_parser{view_input_reader{contents}}.try_parse(log);
+        ASSERT_FALSE(result.has_value()) << sample;
+        EXPECT_EQ(result.error().message, expected) << sample;
+        // Whatever is before the error is told anyway.
+        EXPECT_FALSE(log.events.empty()) << sample;
+    }
+
+    // An array or object is no key, whatever is in it.
+    event_log log;
+    const std::string input = R"({"a": 1, [2, }: 3})";
+    const parse_result<void> result = view_parser{view_input_reader{input}}.try_parse(log);
+    ASSERT_FALSE(result.has_value());
+    EXPECT_EQ(result.error().message, "Expected string as key in JSON object");
+    EXPECT_EQ(log.events, (std::vector<std::string>{"{", "key a", "number 1.000000"}));
+
+    // The same goes for the tape - however deep the array is, it is not gone into.
+    const std::string deep_key = "{" + std::string(default_max_depth + 1, '[') + ": 1}";
+    for (const std::string &bad_key : {input, deep_key}) {
+        try {
+            (void) view_parser{view_input_reader{bad_key}}.parse_via_tape();
+            ADD_FAILURE() << "Expected the tape to fail as well: " << bad_key;
+        } catch (const parser_exception &e) {
+            EXPECT_STREQ(e.what(), "Expected string as key in JSON object");
+        }
+    }
+}
+
+TEST(JsonTests, ParseIntoHandlerWithoutAllocating) {
+    // Only sums up the numbers and counts the rest.
+    struct summing_handler {
+        double sum = 0;
+        std::size_t values = 0;
+
+        void on_null() { ++values; }
+        void on_bool(bool) { ++values; }
+        void on_number(const token_number &value) { sum += value.value(); ++values; }
+        void on_string(std::string_view) { ++values; }
+        void on_key(std::string_view) {}
+        void on_array_begin() {}
+        void on_array_end() { ++values; }
+        void on_object_begin() {}
+        void on_object_end() { ++values; }
+    };
+
+    // However big the input is, the parser allocates just as much.
+    std::vector<std::size_t> allocations;
+    for (int records : {1000, 20000}) {
+        std::string input = "[";
+        for (int i = 0; i < records; ++i)
+            input += "{\"key\": [true, false, null, 12, -3.5e2, \"value\"]},\n";
+        input += "0]";
+
+        summing_handler handler;
+        const std::size_t allocations_before = allocation_count();
+        view_parser{view_input_reader{input}}.parse(handler);
+        allocations.push_back(allocation_count() - allocations_before);
+
+        EXPECT_EQ(handler.sum, records * (12 - 350.0));
+        EXPECT_EQ(handler.values, records * 8 + 2);
+    }
+    EXPECT_EQ(allocations[0], allocations[1]);
+}
+
+TEST(JsonTests, ParseStringsWithoutCopying) {
+    const auto as_string = [](const json &parsed, const char *key) -> const json::string & {
+        return dynamic_cast<const json::string &>(parsed[key]);
+    };
+
+    // The input is gone together with the parser, but the strings keep it around.
+    const json parsed = str_parser{str_input_reader{std::string{R"({ "plain" : "Apple", "escaped" : "a\tb" })"}}}();
+    EXPECT_TRUE(as_string(parsed, "plain").borrowed());
+    EXPECT_EQ(as_string(parsed, "plain"), "Apple");
+    EXPECT_FALSE(as_string(parsed, "escaped").borrowed());
+    EXPECT_EQ(as_string(parsed, "escaped"), "a\tb");
+
+    const json mapped = parse_from_mmap(TESTS_DIR_PREFIX"samples/simple.json");
+    EXPECT_TRUE(as_string(mapped, "fruit").borrowed());
+    EXPECT_EQ(as_string(mapped, "fruit"), "Apple");
+
+    // A view says nothing about how long the memory lives, unless told who owns it.
+    auto owner = std::make_shared<const std::string>(R"({ "fruit" : "Apple" })");
+    const json copied = view_parser{view_input_reader{std::string_view{*owner}}}();
+    EXPECT_FALSE(as_string(copied, "fruit").borrowed());
+    const json borrowed = view_parser{view_input_reader{std::string_view{*owner}, owner}}();
+    owner.reset();
+    EXPECT_TRUE(as_string(borrowed, "fruit").borrowed());
+    EXPECT_EQ(as_string(borrowed, "fruit"), "Apple");
+    EXPECT_EQ(as_string(copied, "fruit"), "Apple");
+
+    // Nothing to refer to when the input is read a piece at a time.
+    const json read = parse_from_file(TESTS_DIR_PREFIX"samples/simple.json");
+    EXPECT_FALSE(as_string(read, "fruit").borrowed());
+    EXPECT_EQ(as_string(read, "fruit"), "Apple");
+}
+
 ///
 /// Bad ones - try parsing unsound JSON and report it.
 ///
 
 TEST(JsonTests, ParseBadUnclosedString) {
     EXPECT_THROW((void) parse_from_file(TESTS_DIR_PREFIX"samples/bad_unclosed_string.json") , json_parser::parser_exception);
+    EXPECT_THROW((void) parse_from_mmap(TESTS_DIR_PREFIX"samples/bad_unclosed_string.json") , json_parser::parser_exception);
 }
 
 TEST(JsonTests, ParseBadExtraComma) {
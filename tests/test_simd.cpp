@@ -0,0 +1,269 @@
+#include <random>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+#include <gtest/gtest.h>
+
+#include <json-parser/simd.h>
+
+using namespace json_parser;
+
+// A symbol at a time version of `simd::index_structurals`.
+static std::vector<std::uint32_t> index_structurals_naive(const std::string &input) {
+    auto is_punct = [](char c) { return c == '{' || c == '}' || c == '[' || c == ']' || c == ':' || c == ','; };
+    auto is_space = [](char c) { return std::isspace(static_cast<unsigned char>(c)) != 0; };
+
+    std::vector<std::uint32_t> positions;
+    bool in_string = false;
+    bool escaped = false;
+    bool follows_scalar = false;
+    for (std::uint32_t i = 0; i < input.size(); ++i) {
+        const char c = input[i];
+        // Just like in the kernels, a backslash escapes the next symbol even outside strings.
+        const bool quote = c == '"' && !escaped;
+        escaped = !escaped && c == '\\';
+
+        if (in_string) {
+            in_string = !quote;
+            follows_scalar = !quote;
+            continue;
+        }
+        if (is_punct(c) || is_space(c)) {
+            if (is_punct(c))
+                positions.push_back(i);
+            follows_scalar = false;
+            continue;
+        }
+        if (!follows_scalar)
+            positions.push_back(i);
+        // A quote stuck to a scalar is not a token start, but it still opens a string.
+        in_string = quote;
+        follows_scalar = !quote;
+    }
+    return positions;
+}
+
+static std::string random_input(std::mt19937 &rng, std::size_t size) {
+    static const std::string alphabet = "{}[]:,\"\\ \n\t\rabtrue0123-.e";
+    std::uniform_int_distribution<std::size_t> pick{0, alphabet.size() - 1};
+    std::string input;
+    for (std::size_t i = 0; i < size; ++i)
+        input += alphabet[pick(rng)];
+    return input;
+}
+
+static std::vector<std::uint32_t> index_with(simd::isa which, const std::string &input) {
+    EXPECT_TRUE(simd::select_isa(which));
+    std::vector<std::uint32_t> positions;
+    simd::index_structurals(input, positions);
+    return positions;
+}
+
+static std::vector<simd::isa> supported_isas() {
+    const simd::isa initial = simd::active_isa();
+    std::vector<simd::isa> isas;
+    for (simd::isa which : {simd::isa::scalar, simd::isa::sse42, simd::isa::avx2})
+        if (simd::select_isa(which))
+            isas.push_back(which);
+    simd::select_isa(initial);
+    return isas;
+}
+
+TEST(SimdTests, IndexStructuralsSimple) {
+    const std::string input = R"({ "a\"[" : [1, true, "x\\"], "b": -2.5e3 })";
+    const std::vector<std::uint32_t> expected = index_structurals_naive(input);
+    // { " : [ 1 , t , " ] , " : - }
+    EXPECT_EQ(expected.size(), 15);
+
+    const simd::isa initial = simd::active_isa();
+    for (simd::isa which : supported_isas())
+        EXPECT_EQ(index_with(which, input), expected) << simd::isa_name(which);
+    simd::select_isa(initial);
+}
+
+TEST(SimdTests, IndexStructuralsMatchesNaive) {
+    std::mt19937 rng{42};
+    const simd::isa initial = simd::active_isa();
+    // The sizes around the block size make sure that the carries between blocks work.
+    for (std::size_t size : {std::size_t{1}, std::size_t{63}, std::size_t{64}, std::size_t{65}, std::size_t{200}, std::size_t{4096}}) {
+        for (int round = 0; round < 50; ++round) {
+            const std::string input = random_input(rng, size);
+            const std::vector<std::uint32_t> expected = index_structurals_naive(input);
+            for (simd::isa which : supported_isas())
+                ASSERT_EQ(index_with(which, input), expected) << simd::isa_name(which) << " on '" << input << "'";
+        }
+    }
+    simd::select_isa(initial);
+}
+
+TEST(SimdTests, SelectScalar) {
+    EXPECT_TRUE(simd::select_isa(simd::isa::scalar));
+    EXPECT_EQ(simd::active_isa(), simd::isa::scalar);
+}
+
+TEST(SimdTests, ScanWhitespaceMatchesNaive) {
+    std::mt19937 rng{7};
+    static const std::string alphabet = " \n\t\r\v\f";
+    std::uniform_int_distribution<std::size_t> pick{0, alphabet.size() - 1};
+
+    const simd::isa initial = simd::active_isa();
+    for (std::size_t length : {std::size_t{0}, std::size_t{1}, std::size_t{63}, std::size_t{64}, std::size_t{130}}) {
+        for (int round = 0; round < 20; ++round) {
+            std::string input;
+            for (std::size_t i = 0; i < length; ++i)
+                input += alphabet[pick(rng)];
+            input += "x  \n";
+
+            for (simd::isa which : supported_isas()) {
+                ASSERT_TRUE(simd::select_isa(which));
+                for (std::size_t max : {length, length + 10, length / 2})
+                    EXPECT_EQ(simd::scan_whitespace(input, max), std::min(max, length)) << simd::isa_name(which);
+            }
+        }
+    }
+    simd::select_isa(initial);
+}
+
+TEST(SimdTests, IndexLineBreaksOutsideStrings) {
+    std::mt19937 rng{21};
+    const simd::isa initial = simd::active_isa();
+    for (std::size_t size : {std::size_t{1}, std::size_t{63}, std::size_t{64}, std::size_t{65}, std::size_t{200}, std::size_t{4096}}) {
+        for (int round = 0; round < 50; ++round) {
+            const std::string input = random_input(rng, size);
+
+            // The same walk as `index_structurals_naive`, looking at the whitespace instead.
+            std::vector<std::uint32_t> expected;
+            bool in_string = false;
+            bool escaped = false;
+            for (std::uint32_t i = 0; i < input.size(); ++i) {
+                const char c = input[i];
+                const bool quote = c == '"' && !escaped;
+                escaped = !escaped && c == '\\';
+                if (in_string) {
+                    in_string = !quote;
+                    continue;
+                }
+                in_string = quote;
+                const simd::line_break kind = c == '\n' ? simd::line_break::newline
+                                              : c == '\r' ? simd::line_break::carriage_return
+                                                          : simd::line_break::tab;
+                if (c == '\n' || c == '\r' || c == '\t')
+                    expected.push_back(i | static_cast<std::uint32_t>(kind) << simd::line_break_shift);
+            }
+
+            for (simd::isa which : supported_isas()) {
+                ASSERT_TRUE(simd::select_isa(which));
+                std::vector<std::uint32_t> positions;
+                std::vector<std::uint32_t> line_breaks;
+                simd::index_structurals(input, positions, line_breaks);
+                ASSERT_EQ(line_breaks, expected) << simd::isa_name(which) << " on '" << input << "'";
+                ASSERT_EQ(positions, index_structurals_naive(input)) << simd::isa_name(which);
+            }
+        }
+    }
+    simd::select_isa(initial);
+}
+
+TEST(SimdTests, ScanStringFindsQuoteOrBackslash) {
+    const simd::isa initial = simd::active_isa();
+    for (std::size_t length : {std::size_t{0}, std::size_t{5}, std::size_t{63}, std::size_t{64}, std::size_t{200}}) {
+        const std::string body(length, 'a');
+        for (simd::isa which : supported_isas()) {
+            ASSERT_TRUE(simd::select_isa(which));
+            EXPECT_EQ(simd::scan_string(body), length) << simd::isa_name(which);
+            EXPECT_EQ(simd::scan_string(body + "\"x\\"), length) << simd::isa_name(which);
+            EXPECT_EQ(simd::scan_string(body + "\\\"x"), length) << simd::isa_name(which);
+            // Only the given part of the input is looked at.
+            const std::string with_quote = body + '"';
+            EXPECT_EQ(simd::scan_string(std::span<const char>{with_quote}.first(length)), length) << simd::isa_name(which);
+        }
+    }
+    simd::select_isa(initial);
+}
+
+// A symbol at a time version of `simd::validate_utf8`, straight from RFC 3629.
+static bool validate_utf8_naive(const std::string &input) {
+    for (std::size_t i = 0; i < input.size();) {
+        const auto lead = static_cast<unsigned char>(input[i]);
+        std::size_t length;
+        char32_t code_point;
+        if (lead < 0x80) {
+            ++i;
+            continue;
+        } else if (lead >= 0xc2 && lead <= 0xdf) {
+            length = 2;
+            code_point = lead & 0x1f;
+        } else if (lead >= 0xe0 && lead <= 0xef) {
+            length = 3;
+            code_point = lead & 0x0f;
+        } else if (lead >= 0xf0 && lead <= 0xf4) {
+            length = 4;
+            code_point = lead & 0x07;
+        } else {
+            return false;
+        }
+        if (i + length > input.size())
+            return false;
+        for (std::size_t j = 1; j < length; ++j) {
+            const auto continuation = static_cast<unsigned char>(input[i + j]);
+            if ((continuation & 0xc0) != 0x80)
+                return false;
+            code_point = code_point << 6 | (continuation & 0x3f);
+        }
+        const char32_t smallest[] = {0, 0, 0x80, 0x800, 0x10000};
+        if (code_point < smallest[length] || code_point > 0x10ffff || (code_point >= 0xd800 && code_point <= 0xdfff))
+            return false;
+        i += length;
+    }
+    return true;
+}
+
+TEST(SimdTests, ValidateUtf8MatchesNaive) {
+    // Mostly valid pieces, so that the errors are rare enough to end up anywhere in the blocks.
+    static const std::vector<std::string> pieces = {
+        "a", "bc", "\x7f", "\xc3\xa9", "\xdf\xbf", "\xe2\x82\xac", "\xed\x9f\xbf", "\xef\xbf\xbf",
+        "\xf0\x9f\x98\x80", "\xf4\x8f\xbf\xbf",
+        // Overlong, surrogates, too large, stray continuations and leads without them.
+        "\xc0\x80", "\xc1\xbf", "\xe0\x80\x80", "\xed\xa0\x80", "\xf0\x80\x80\x80", "\xf4\x90\x80\x80",
+        "\xf5\x80\x80\x80", "\xff", "\x80", "\xbf", "\xc3", "\xe2\x82", "\xf0\x9f\x98",
+    };
+    std::mt19937 rng{19};
+    std::uniform_int_distribution<std::size_t> pick_valid{0, 9};
+    std::uniform_int_distribution<std::size_t> pick_any{0, pieces.size() - 1};
+    std::uniform_int_distribution<int> one_in{0, 99};
+
+    const simd::isa initial = simd::active_isa();
+    for (std::size_t size : {std::size_t{1}, std::size_t{30}, std::size_t{63}, std::size_t{64}, std::size_t{65}, std::size_t{200}, std::size_t{1000}}) {
+        for (int round = 0; round < 100; ++round) {
+            std::string input;
+            while (input.size() < size)
+                input += pieces[one_in(rng) == 0 ? pick_any(rng) : pick_valid(rng)];
+            const bool expected = validate_utf8_naive(input);
+            for (simd::isa which : supported_isas()) {
+                ASSERT_TRUE(simd::select_isa(which));
+                ASSERT_EQ(simd::validate_utf8(input), expected) << simd::isa_name(which) << " on a " << input.size() << " byte input";
+            }
+        }
+    }
+    simd::select_isa(initial);
+}
+
+TEST(SimdTests, ValidateUtf8AtTheEdges) {
+    const simd::isa initial = simd::active_isa();
+    for (std::size_t prefix : {std::size_t{0}, std::size_t{61}, std::size_t{62}, std::size_t{63}, std::size_t{64}, std::size_t{127}}) {
+        const std::string ascii(prefix, 'x');
+        for (simd::isa which : supported_isas()) {
+            ASSERT_TRUE(simd::select_isa(which));
+            // Cut short at the very end of the input.
+            EXPECT_TRUE(simd::validate_utf8(ascii + "\xf0\x9f\x98\x80")) << simd::isa_name(which) << ' ' << prefix;
+            EXPECT_FALSE(simd::validate_utf8(ascii + "\xf0\x9f\x98")) << simd::isa_name(which) << ' ' << prefix;
+            EXPECT_FALSE(simd::validate_utf8(ascii + "\xe2")) << simd::isa_name(which) << ' ' << prefix;
+            // Going across the blocks.
+            EXPECT_TRUE(simd::validate_utf8(ascii + "\xe2\x82\xac" + ascii)) << simd::isa_name(which) << ' ' << prefix;
+            EXPECT_FALSE(simd::validate_utf8(ascii + "\xe2\x82" + ascii)) << simd::isa_name(which) << ' ' << prefix;
+            EXPECT_FALSE(simd::validate_utf8(ascii + "\xed\xa0\x80" + ascii)) << simd::isa_name(which) << ' ' << prefix;
+        }
+    }
+    simd::select_isa(initial);
+}
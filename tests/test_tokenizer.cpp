@@ -3,12 +3,16 @@
 #include <sstream>
 #include <tuple>
 #include <iterator>
+#include <charconv>
+#include <cmath>
+#include <random>
 
 #include <mystd/memory.h>
 
 #include <json-parser/tokenizer.h>
 
 #include <json-parser-tests/common.h>
+#include <json-parser-tests/allocations.h>
 
 using namespace json_parser;
 
@@ -24,8 +28,7 @@ static tokenized_details tokenize_and_get_details(const std::string &json_input_
     auto it = tokenizer.begin();
     auto end_it = tokenizer.end();
     for ( ; it != end_it; ++it) {
-        mystd::unique_ptr<token> tok = *it;
-        tok->serialize(sstr);
+        it->serialize(sstr);
         ++num_tokens;
     }
 
@@ -78,3 +81,448 @@ TEST(JsonTests, TokenizeBadUnclosedString)
 TEST(JsonTests, TokenizeOrganization) {
     EXPECT_NO_THROW(tokenize_and_get_details(TESTS_DIR_PREFIX"samples/organisation.json"));
 }
+
+TEST(JsonTests, TokenizeWithoutTrailingWhitespace) {
+    str_tokenizer tokenizer{str_input_reader{"[1,true]"}};
+    std::ostringstream sstr;
+    std::size_t num_tokens = 0;
+    for (auto it = tokenizer.begin(); it != tokenizer.end(); ++it) {
+        it->serialize(sstr);
+        ++num_tokens;
+    }
+
+    EXPECT_EQ(num_tokens, 5);
+    EXPECT_EQ(sstr.str(), "[1,true]");
+}
+
+TEST(JsonTests, TokenizeDoesNotReopenInput) {
+    // Once the reader is created, the file is not needed by its name anymore -
+    // all of the iterators share the already opened input.
+    const std::string path = (fs::temp_directory_path() / "fmi-json-parser-unlinked.json").string();
+    fs::copy_file(TESTS_DIR_PREFIX"samples/simple.json", path, fs::copy_options::overwrite_existing);
+
+    ifs_parser parser{ifs_input_reader{path}};
+    fs::remove(path);
+
+    const json parsed = std::move(parser)();
+    const json::string &fruit_val = dynamic_cast<const json::string &>(parsed["fruit"]);
+    EXPECT_EQ(fruit_val, "Apple");
+}
+
+TEST(JsonTests, TokenizeLargeInputWithEveryKernel) {
+    // Way more than a single chunk of the structural index, with strings which look like
+    // they contain tokens and some stuck tokens which do not match what the index expects.
+    std::string input = "[";
+    for (int i = 0; i < 2000; ++i)
+        input += "\n  {\"k\\\"ey[\" :\t-12.5e3, \"v\\\\\": [true,null , false]},";
+    input += "12\"x\" ]";
+
+    const simd::isa initial = simd::active_isa();
+    std::string expected;
+    for (simd::isa which : {simd::isa::scalar, simd::isa::sse42, simd::isa::avx2}) {
+        if (!simd::select_isa(which))
+            continue;
+        view_tokenizer tokenizer{view_input_reader{input}};
+        std::ostringstream sstr;
+        for (auto it = tokenizer.begin(); it != tokenizer.end(); ++it)
+            it->serialize(sstr);
+        if (expected.empty())
+            expected = sstr.str();
+        EXPECT_EQ(sstr.str(), expected) << simd::isa_name(which);
+    }
+    simd::select_isa(initial);
+
+    EXPECT_EQ(expected.substr(0, 42), R"([{"k\"ey[":-12500,"v\\":[true,null,false]})");
+    EXPECT_EQ(expected.substr(expected.size() - 6), R"(12"x"])");
+}
+
+TEST(JsonTests, TokenizeLongStrings) {
+    // Longer than a window of the buffered reader, with escapes here and there.
+    std::string blob;
+    for (int i = 0; i < 5000; ++i)
+        blob += i % 1000 == 999 ? "\\n" : "QUJD";
+    const std::string input = "[\"" + blob + "\", \"\"]";
+
+    std::string expected_value;
+    for (int i = 0; i < 5000; ++i)
+        expected_value += i % 1000 == 999 ? "\n" : "QUJD";
+
+    for (std::size_t block_size : {std::size_t{7}, std::size_t{4096}}) {
+        const std::string path = (fs::temp_directory_path() / "fmi-json-parser-long-strings.json").string();
+        std::ofstream{path, std::ios::binary | std::ios::trunc} << input;
+        buf_tokenizer tokenizer{buf_input_reader{path, block_size}};
+        fs::remove(path);
+
+        std::vector<std::string> strings;
+        for (auto it = tokenizer.begin(); it != tokenizer.end(); ++it) {
+            if (it->type() == token_value::kind::String)
+                strings.emplace_back(it->string());
+        }
+        ASSERT_EQ(strings.size(), 2);
+        EXPECT_EQ(strings[0], expected_value);
+        EXPECT_EQ(strings[1], "");
+    }
+}
+
+template <typename Tokenizer>
+static void tokenize_all(Tokenizer &tokenizer) {
+    for (auto it = tokenizer.begin(); it != tokenizer.end(); ++it)
+        (void) *it;
+}
+
+// What the tokenizer reports - so that it can be compared between the input readers.
+template <typename Tokenizer>
+static std::string tokenize_error(Tokenizer &&tokenizer) {
+    try {
+        tokenize_all(tokenizer);
+    } catch (const token_exception &e) {
+        return e.what();
+    }
+    return "no error";
+}
+
+TEST(JsonTests, TokenizeKeywords) {
+    const std::string input = "[true,false,null,\ttrue ,false]";
+    const std::vector<token_keyword::kind> expected = {token_keyword::kind::True, token_keyword::kind::False,
+                                                       token_keyword::kind::Null, token_keyword::kind::True,
+                                                       token_keyword::kind::False};
+
+    // Whole in the window, cut by its end and at the very end of the input.
+    for (std::size_t block_size : {std::size_t{1}, std::size_t{4}, std::size_t{5}, std::size_t{6}, std::size_t{4096}}) {
+        for (const std::string &doc : {input, std::string{"false"}}) {
+            const std::string path = (fs::temp_directory_path() / "fmi-json-parser-keywords.json").string();
+            std::ofstream{path, std::ios::binary | std::ios::trunc} << doc;
+            buf_tokenizer tokenizer{buf_input_reader{path, block_size}};
+            fs::remove(path);
+
+            std::vector<token_keyword::kind> keywords;
+            for (auto it = tokenizer.begin(); it != tokenizer.end(); ++it) {
+                if (it->type() == token_value::kind::Keyword)
+                    keywords.push_back(it->keyword());
+            }
+            if (doc == input) {
+                EXPECT_EQ(keywords, expected) << block_size;
+            } else {
+                EXPECT_EQ(keywords, std::vector{token_keyword::kind::False}) << block_size;
+            }
+        }
+    }
+
+    for (const std::string &bad : std::vector<std::string>{"truex", "nul", "nulll", "True", "fals", "[nullx]", std::string{"[\0]", 3}}) {
+        view_tokenizer tokenizer{view_input_reader{bad}};
+        EXPECT_THROW(tokenize_all(tokenizer), token_exception) << bad;
+    }
+}
+
+TEST(JsonTests, TokenizeEscapes) {
+    const std::string input = R"(["\"\\\/\b\f\n\r\t", "caf\u00e9 \u20AC \ud83d\ude00", "\u0000"])";
+    const std::vector<std::string> expected = {"\"\\/\b\f\n\r\t", "caf\xc3\xa9 \xe2\x82\xac \xf0\x9f\x98\x80", std::string(1, '\0')};
+
+    view_tokenizer tokenizer{view_input_reader{input}};
+    std::vector<std::string> strings;
+    std::ostringstream sstr;
+    for (auto it = tokenizer.begin(); it != tokenizer.end(); ++it) {
+        if (it->type() == token_value::kind::String)
+            strings.emplace_back(it->string());
+        it->serialize(sstr);
+    }
+    EXPECT_EQ(strings, expected);
+    // Printed back as valid JSON, with only what has to be escaped.
+    EXPECT_EQ(sstr.str(), "[\"\\\"\\\\/\\b\\f\\n\\r\\t\",\"caf\xc3\xa9 \xe2\x82\xac \xf0\x9f\x98\x80\",\"\\u0000\"]");
+}
+
+TEST(JsonTests, TokenizeBadEscapes) {
+    for (const std::string input : {R"("\x")", R"("\u12")", R"("\u12g4")", R"("\ud83d")", R"("\ud83dx")",
+                                    R"("\ud83d\u0041")", R"("\ude00")", R"("\)"}) {
+        view_tokenizer tokenizer{view_input_reader{input}};
+        EXPECT_THROW(tokenize_all(tokenizer), token_exception) << input;
+    }
+}
+
+TEST(JsonTests, TokenizeUtf8) {
+    std::string body;
+    for (int i = 0; i < 300; ++i)
+        body += "a\xc3\xa9\xe2\x82\xac\xf0\x9f\x98\x80";
+    const std::string input = "[\"" + body + "\", \"" + body + "\\n\"]";
+
+    // The windows of the buffered reader end in the middle of the symbols here and there.
+    for (std::size_t block_size : {std::size_t{1}, std::size_t{3}, std::size_t{5}, std::size_t{7}, std::size_t{4096}}) {
+        const std::string path = (fs::temp_directory_path() / "fmi-json-parser-utf8.json").string();
+        std::ofstream{path, std::ios::binary | std::ios::trunc} << input;
+        buf_tokenizer tokenizer{buf_input_reader{path, block_size}};
+        fs::remove(path);
+
+        std::vector<std::string> strings;
+        for (auto it = tokenizer.begin(); it != tokenizer.end(); ++it) {
+            if (it->type() == token_value::kind::String)
+                strings.emplace_back(it->string());
+        }
+        ASSERT_EQ(strings.size(), 2) << block_size;
+        EXPECT_EQ(strings[0], body) << block_size;
+        EXPECT_EQ(strings[1], body + "\n") << block_size;
+    }
+
+    // The bad symbol is reported where it is, however the windows are.
+    for (const std::string input : {"\"\xc3\"", "\"a\xe2\x82\"", "\"\xed\xa0\x80\"", "\"\xc0\xaf\"", "\"\xff\"", "\"\x80\\n\"",
+                                    "[\"abcdefghijklmnop\xff\"]", "[\"x\", \"\xe2\x82\xac\xf0\x80\x80\x80 \"]", "\"\xd0\xbc\xd0\"",
+                                    "{\"\xe2\x82\xac\xe2\x82\xac\xe2\x82\xac\": \"\xe2\x82\xac\xe2\x82\xac\xe2\x82\xff\xac\"}"}) {
+        const std::string expected = tokenize_error(view_tokenizer{view_input_reader{input}});
+        EXPECT_NE(expected.find("Invalid UTF-8"), std::string::npos) << input << ": " << expected;
+        EXPECT_EQ(tokenize_error(str_tokenizer{str_input_reader{input}}), expected) << input;
+
+        const std::string path = (fs::temp_directory_path() / "fmi-json-parser-bad-utf8.json").string();
+        std::ofstream{path, std::ios::binary | std::ios::trunc} << input;
+        for (const std::size_t block_size : {1, 2, 3, 5, 7, 64}) {
+            buf_tokenizer buffered{buf_input_reader{path, block_size}};
+            EXPECT_EQ(tokenize_error(buffered), expected) << input << " " << block_size;
+        }
+        fs::remove(path);
+    }
+}
+
+static double tokenize_number(const std::string &input) {
+    view_tokenizer tokenizer{view_input_reader{input}};
+    auto it = tokenizer.begin();
+    const token_value tok = *it;
+    EXPECT_EQ(++it, tokenizer.end()) << input;
+    EXPECT_EQ(tok.type(), token_value::kind::Number) << input;
+    return tok.number().value();
+}
+
+TEST(JsonTests, TokenizeNumbersExactly) {
+    for (const std::string input : {"0", "-0", "1", "-12.5e3", "0.1", "0.30000000000000004",
+                                    "123456789012345678901234567890", "9007199254740993",
+                                    "2.2250738585072014e-308", "4.9e-324", "1.7976931348623157e308",
+                                    "1E+2", "1e-2", "0.000000000000000000000000001"}) {
+        const double expected = std::strtod(input.c_str(), nullptr);
+        EXPECT_EQ(tokenize_number(input), expected) << input;
+    }
+    EXPECT_EQ(tokenize_number("1e400"), std::numeric_limits<double>::infinity());
+    EXPECT_EQ(tokenize_number("-1e-400"), 0);
+
+    // The shortest representation of a double (as given by `std::to_chars`) is read as that double.
+    std::mt19937_64 rng{14};
+    for (int i = 0; i < 10000; ++i) {
+        double expected;
+        do {
+            const std::uint64_t bits = rng();
+            std::memcpy(&expected, &bits, sizeof(expected));
+        } while (!std::isfinite(expected));
+        char buf[64];
+        const auto [end, ec] = std::to_chars(buf, buf + sizeof(buf), expected);
+        ASSERT_EQ(tokenize_number(std::string(buf, end)), expected) << std::string(buf, end);
+    }
+}
+
+TEST(JsonTests, TokenizeBadNumbers) {
+    for (const std::string input : {"1-2", "1-2e+", "01", "-", "1.", "1.e5", "1e", "1e+", "--1", "1.2.3", "1e5e5", "-a"}) {
+        view_tokenizer tokenizer{view_input_reader{input}};
+        EXPECT_THROW(tokenize_all(tokenizer), token_exception) << input;
+    }
+
+    // The same, with numbers going past the windows of the reader - which are reported at
+    // the same place as when the whole input is there.
+    for (const std::string input : {"[1.5, 1-2]", "[12345678, 123.]", "[1.2.3]", "\n  [1e5e5, 2]", "[123456-789]"}) {
+        const std::string expected = tokenize_error(view_tokenizer{view_input_reader{input}});
+        EXPECT_NE(expected, "no error") << input;
+
+        const std::string path = (fs::temp_directory_path() / "fmi-json-parser-bad-number.json").string();
+        std::ofstream{path, std::ios::binary | std::ios::trunc} << input;
+        for (const std::size_t block_size : {2, 3, 5}) {
+            buf_tokenizer tokenizer{buf_input_reader{path, block_size}};
+            EXPECT_EQ(tokenize_error(tokenizer), expected) << input << " " << block_size;
+        }
+        fs::remove(path);
+    }
+}
+
+TEST(JsonTests, TokenizeWithoutAllocating) {
+    std::string input = "[";
+    for (int i = 0; i < 20000; ++i)
+        input += "{\"key\": [true, false, null, 12, -3.5e2]},\n";
+    input += "0]";
+
+    view_tokenizer tokenizer{view_input_reader{input}};
+    auto it = tokenizer.begin();
+    const std::size_t allocations_before = allocation_count();
+    std::size_t tokens = 0;
+    std::size_t puncts = 0;
+    for (; it != tokenizer.end(); ++it) {
+        puncts += it->type() == token_value::kind::Punct;
+        ++tokens;
+    }
+    const std::size_t allocations = allocation_count() - allocations_before;
+
+    EXPECT_EQ(tokens, 1 + 20000 * 16 + 2);
+    EXPECT_EQ(puncts, 1 + 20000 * 10 + 1);
+    EXPECT_EQ(allocations, 0);
+}
+
+TEST(JsonTests, TokenizeIntoTape) {
+    const std::string input = R"({"a": [1, [2, 3], {}], "b": "x\ty", "c": null} ])";
+    view_tokenizer tokenizer{view_input_reader{input}};
+    const token_tape tape = tokenizer.tape();
+    ASSERT_EQ(tape.size(), 25);
+
+    // The brackets know their pairs, the one left over does not.
+    EXPECT_EQ(tape[0].match, 23);
+    EXPECT_EQ(tape[23].match, 0);
+    EXPECT_EQ(tape[3].match, 14);
+    EXPECT_EQ(tape[24].match, token_tape::npos);
+
+    // So whole values can be skipped at once.
+    EXPECT_EQ(tape.skip(3), 15);
+    EXPECT_EQ(tape.skip(6), 11);
+    EXPECT_EQ(tape.skip(4), 5);
+    EXPECT_EQ(tape.skip(0), 24);
+
+    EXPECT_EQ(tape.number(tape[4]).int64_value(), 1);
+    EXPECT_EQ(tape[18].kind, token_value::kind::String);
+    EXPECT_EQ(tape.string(tape[18]), "x\ty");
+    EXPECT_EQ(tape[22].keyword, token_keyword::kind::Null);
+
+    // Every entry knows where in the input it is.
+    for (const tape_entry &entry : tape) {
+        const std::string_view source = std::string_view{input}.substr(entry.offset, entry.length);
+        if (entry.kind == token_value::kind::Punct) {
+            EXPECT_EQ(source, std::string(1, entry.punct));
+        }
+        if (entry.kind == token_value::kind::String) {
+            // The escape sequences take more than what they stand for.
+            EXPECT_GE(source.size(), entry.value_length + 2);
+            EXPECT_EQ(source.front(), '"');
+            EXPECT_EQ(source.back(), '"');
+        }
+    }
+}
+
+TEST(JsonTests, TokenizeIntoTapeInParallel) {
+    // A couple of megabytes, so that there are chunks at all, with whatever may fool them
+    // into starting in the wrong place - escaped quotes, runs of backslashes and strings which
+    // look like JSON and are long enough to be cut in two.
+    std::string input = "[";
+    for (std::size_t i = 0; input.size() < (3 << 20); ++i) {
+        input += R"({"id": )" + std::to_string(i) + R"(, "text": "say \"[1, 2]\", \\\\", "path": "C:\\dir\\", )";
+        input += R"("score": -)" + std::to_string(i) + R"(.5e-3, "ok": [true, false, null], "blob": ")";
+        if (i % 97 == 0) {
+            for (std::size_t j = 0; j < 20000; ++j)
+                input += j % 3 ? "\\\"{" : "],\xd0\xbc";
+        }
+        input += R"("}, )";
+    }
+    input += R"("\u0436"]]})";
+    const token_tape expected = view_tokenizer{view_input_reader{input}}.tape();
+
+    for (std::size_t threads = 0; threads <= 3; ++threads) {
+        const token_tape tape = parallel_tape(input, threads);
+        ASSERT_EQ(tape.size(), expected.size()) << threads;
+        for (std::size_t i = 0; i < tape.size(); ++i) {
+            const tape_entry &entry = tape[i];
+            const tape_entry &other = expected[i];
+            ASSERT_EQ(entry.kind, other.kind) << i;
+            ASSERT_EQ(entry.offset, other.offset) << i;
+            ASSERT_EQ(entry.length, other.length) << i;
+            if (entry.kind == token_value::kind::Punct) {
+                ASSERT_EQ(entry.punct, other.punct) << i;
+                ASSERT_EQ(tape.skip(i), expected.skip(i)) << i;
+            } else if (entry.kind == token_value::kind::String) {
+                ASSERT_EQ(tape.string(entry), expected.string(other)) << i;
+            } else if (entry.kind == token_value::kind::Number) {
+                ASSERT_EQ(tape.number(entry).value(), expected.number(other).value()) << i;
+            } else {
+                ASSERT_EQ(entry.keyword, other.keyword) << i;
+            }
+        }
+    }
+
+    // The errors are the same as when tokenizing in one go.
+    input.replace(input.find("true", input.size() / 2), 4, "tru!");
+    const token_tape failed = view_tokenizer{view_input_reader{input}}.tape();
+    ASSERT_TRUE(failed.failed());
+    EXPECT_LT(failed.size(), expected.size());
+    const std::string expected_error = failed.error().message;
+    const token_tape tape = parallel_tape(input, 4);
+    ASSERT_TRUE(tape.failed());
+    EXPECT_EQ(tape.error().message, expected_error);
+    EXPECT_EQ(tape.size(), failed.size());
+}
+
+TEST(JsonTests, TokenizeKeepsTrackOfLocationThroughWhitespace) {
+    // The location has to be the same as when following the whitespace a symbol at a time.
+    const std::string whitespace = "  \n\t \r  \t\t\n   \t  \n\n \r\t   ";
+    for (std::size_t length = 0; length <= whitespace.size(); ++length) {
+        const std::string prefix = std::string{"[1,"} + whitespace.substr(0, length);
+
+        std::size_t line = 0, column = 0;
+        for (char c : prefix) {
+            switch (c) {
+            case '\n': column = 0; ++line; break;
+            case '\t': column += 4; ++line; break;
+            case '\r': column = 0; break;
+            default: ++column;
+            }
+        }
+        // The offending symbol itself is taken as well.
+        ++column;
+
+        str_tokenizer tokenizer{str_input_reader{prefix + "@]"}};
+        try {
+            for (auto it = tokenizer.begin(); it != tokenizer.end(); ++it)
+                (void) *it;
+            FAIL() << "Expected the tokenizer to fail.";
+        } catch (const token_exception &e) {
+            const std::string expected = "Line: " + std::to_string(line) + ", Column: " + std::to_string(column) + " ";
+            EXPECT_NE(std::string{e.what()}.find(expected), std::string::npos) << e.what() << " vs " << expected;
+        }
+    }
+}
+
+TEST(JsonTests, TokenizeWorksOutLocationAcrossIndexWindows) {
+    // Long enough to go through a couple of structural index windows. The whitespace in the
+    // strings takes a single column, just like any other symbol there.
+    std::string input = "[";
+    for (int i = 0; i < 3000; ++i)
+        input += i % 7 ? "\"a\tb\nc\",\r\n\t" : "{ \"k\" :\t1 }  ,\n";
+    const std::size_t first_line_length = input.find('\n');
+
+    std::size_t line = 0, column = 0;
+    bool in_string = false;
+    for (char c : input) {
+        if (c == '"')
+            in_string = !in_string;
+        if (in_string) {
+            ++column;
+            continue;
+        }
+        switch (c) {
+        case '\n': column = 0; ++line; break;
+        case '\t': column += 4; ++line; break;
+        case '\r': column = 0; break;
+        default: ++column;
+        }
+    }
+    const std::string expected = "Line: " + std::to_string(line) + ", Column: " + std::to_string(column + 1) + " ";
+    input += "@]";
+
+    auto expect_location = [&](auto &&tokenizer, const char *which) {
+        auto it = tokenizer.begin();
+        ++it;
+        // The copy stays behind, where the first line is not over yet.
+        const auto copy = it;
+        try {
+            for (; it != tokenizer.end(); ++it)
+                (void) *it;
+            ADD_FAILURE() << "Expected the tokenizer to fail: " << which;
+        } catch (const token_exception &e) {
+            EXPECT_NE(std::string{e.what()}.find(expected), std::string::npos) << which << ": " << e.what() << " vs " << expected;
+        }
+        EXPECT_EQ(copy.current_location().line_num(), 0) << which;
+        EXPECT_LT(copy.current_location().column_num(), first_line_length) << which;
+    };
+
+    expect_location(view_tokenizer{view_input_reader{input}}, "view");
+    const std::string path = (fs::temp_directory_path() / "fmi-json-parser-location.json").string();
+    std::ofstream{path, std::ios::binary | std::ios::trunc} << input;
+    expect_location(buf_tokenizer{buf_input_reader{path, 7}}, "buf");
+    fs::remove(path);
+}